@@ -0,0 +1,127 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <utility>
+#include "delegate.h"
+
+namespace delegate
+{
+    /**
+     * A C callback: a function pointer and the context (user data) pointer to pass along with it.
+     *
+     * @tparam Function The C function pointer type.
+     */
+    template<typename Function>
+    struct CCallback
+    {
+        /** The function to register. */
+        Function function;
+
+        /** The context to register with it. */
+        void *context;
+    };
+
+    /**
+     * Trampolines from C callbacks, which take a context pointer with their arguments (e.g. sqlite3_exec, libuv, zlib
+     * allocators), to the delegate passed as the context.  There is one trampoline per signature, so the delegate
+     * may be reassigned while it is registered.
+     *
+     * @tparam DelegateType The delegate type.
+     */
+    template<typename DelegateType>
+    struct CBridge;
+
+    template<template<typename, typename...> class DelegateType, typename Result, typename... Arguments>
+    struct CBridge<DelegateType<Result, Arguments...>>
+    {
+        /** A C callback taking the context before its arguments. */
+        using ContextFirst = Result (*)(void *context, Arguments... arguments);
+
+        /** A C callback taking the context after its arguments (e.g. qsort_r). */
+        using ContextLast = Result (*)(Arguments... arguments, void *context);
+
+        /**
+         * Call the delegate passed as the context.
+         *
+         * @param context The delegate.
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        static Result context_first(void *context, Arguments... arguments)
+        {
+            return (*static_cast<const DelegateType<Result, Arguments...> *>(context))(
+                std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * Call the delegate passed as the context.
+         *
+         * @param arguments The arguments to pass through to the delegate.
+         * @param context The delegate.
+         *
+         * @return Returns the Result type.
+         */
+        static Result context_last(Arguments... arguments, void *context)
+        {
+            return (*static_cast<const DelegateType<Result, Arguments...> *>(context))(
+                std::forward<Arguments>(arguments)...);
+        }
+    };
+
+    /**
+     * Returns a C callback which calls a delegate, for C APIs taking the context before the arguments.  Nothing is
+     * allocated - the context points at the delegate, which must outlive the registration.
+     *
+     * Example:
+     *      delegate::Delegate<int, int, char **, char **> on_row = [&rows](int, char **, char **){...};
+     *      const auto callback = delegate::c_callback(on_row);
+     *      sqlite3_exec(db, sql, callback.function, callback.context, &error);
+     *
+     * @param delegate The delegate.
+     *
+     * @return The callback.
+     */
+    template<template<typename, typename...> class DelegateType, typename Result, typename... Arguments>
+    CCallback<Result (*)(void *, Arguments...)> c_callback(const DelegateType<Result, Arguments...> &delegate)
+    {
+        return {&CBridge<DelegateType<Result, Arguments...>>::context_first,
+                const_cast<void *>(static_cast<const void *>(&delegate))};
+    }
+
+    /**
+     * Returns a C callback which calls a delegate, for C APIs taking the context after the arguments.  Nothing is
+     * allocated - the context points at the delegate, which must outlive the registration.
+     *
+     * @param delegate The delegate.
+     *
+     * @return The callback.
+     */
+    template<template<typename, typename...> class DelegateType, typename Result, typename... Arguments>
+    CCallback<Result (*)(Arguments..., void *)> c_callback_context_last(
+        const DelegateType<Result, Arguments...> &delegate)
+    {
+        return {&CBridge<DelegateType<Result, Arguments...>>::context_last,
+                const_cast<void *>(static_cast<const void *>(&delegate))};
+    }
+}
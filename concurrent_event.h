@@ -0,0 +1,555 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <numeric>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "delegate.h"
+#include "thread_pool.h"
+
+namespace delegate
+{
+    /** Allow the maximum number of threads concurrently emitting events to be specified as a compile-time constant. */
+    #ifndef DELEGATE_MAX_READER_THREADS
+     #define DELEGATE_MAX_READER_THREADS 256
+     #define DELEGATE_MAX_READER_THREADS_UNDEF
+    #endif
+
+    /**
+     * Epoch based reclamation for the snapshots published by concurrent events.  Each reading thread announces the
+     * global epoch in its own cache line while reading, and writers wait for every announced epoch to move past the
+     * one they retired a snapshot in before freeing it.  Readers never lock and never write a cache line shared with
+     * another thread.  A thread takes a reader record (under a lock) the first time it reads, and gives it back when
+     * it exits.
+     */
+    class EpochDomain
+    {
+    public:
+        /** The maximum number of threads with a reader record at once. */
+        static constexpr size_t max_readers = DELEGATE_MAX_READER_THREADS;
+
+        /**
+         * Returns the process wide domain.
+         *
+         * @return The domain.
+         */
+        static EpochDomain &instance()
+        {
+            static EpochDomain domain;
+
+            return domain;
+        }
+
+        /** Read-side critical section.  Snapshots loaded while one is alive won't be freed until it's destroyed. */
+        class ReadGuard
+        {
+        public:
+            /** Constructor.  Enters a read-side critical section. */
+            ReadGuard()
+            {
+                instance().enter();
+            }
+
+            /** Destructor.  Leaves the read-side critical section. */
+            ~ReadGuard()
+            {
+                instance().exit();
+            }
+
+            ReadGuard(const ReadGuard &other) = delete;
+            ReadGuard &operator=(const ReadGuard &other) = delete;
+        };
+
+        /**
+         * Returns whether the calling thread is in a read-side critical section.
+         *
+         * @return True if reading, else false.
+         */
+        bool reading()
+        {
+            return this_reader().depth > 0;
+        }
+
+        /**
+         * Wait until every read-side critical section which might have loaded a snapshot before this call has ended.
+         * Must not be called from within a read-side critical section.
+         */
+        void synchronize()
+        {
+            const uint64_t epoch = global_epoch.fetch_add(1) + 1;
+
+            for (Record &record : records)
+            {
+                for (uint64_t announced = record.epoch.load(); announced != 0 && announced < epoch;
+                     announced = record.epoch.load())
+                {
+                    std::this_thread::yield();
+                }
+            }
+        }
+
+    private:
+        /** A reading thread's announced epoch, 0 when not reading.  Each is in its own cache line. */
+        struct alignas(64) Record
+        {
+            std::atomic<uint64_t> epoch{0};
+        };
+
+        /** The calling thread's reader state. */
+        struct Reader
+        {
+            /** Constructor.  Takes a reader record. */
+            Reader() : index(instance().acquire())
+            {
+            }
+
+            /** Destructor.  Gives the reader record back. */
+            ~Reader()
+            {
+                instance().release(index);
+            }
+
+            /** Index of the thread's reader record. */
+            size_t index;
+
+            /** Read-side critical section nesting depth. */
+            size_t depth = 0;
+        };
+
+        /**
+         * Returns the calling thread's reader state.
+         *
+         * @return The reader state.
+         */
+        static Reader &this_reader()
+        {
+            static thread_local Reader reader;
+
+            return reader;
+        }
+
+        /** Enter a read-side critical section, announcing the current epoch if not already reading. */
+        void enter()
+        {
+            Reader &reader = this_reader();
+            if (reader.depth++ == 0)
+            {
+                records[reader.index].epoch.store(global_epoch.load(std::memory_order_relaxed));
+            }
+        }
+
+        /** Leave a read-side critical section. */
+        void exit()
+        {
+            Reader &reader = this_reader();
+            if (--reader.depth == 0)
+            {
+                records[reader.index].epoch.store(0, std::memory_order_release);
+            }
+        }
+
+        /**
+         * Take a free reader record.
+         *
+         * @return The reader record index.
+         */
+        size_t acquire()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!free_records.empty())
+            {
+                size_t index = free_records.back();
+                free_records.pop_back();
+
+                return index;
+            }
+
+            if (next_record == max_readers)
+            {
+                // More threads are reading at once than DELEGATE_MAX_READER_THREADS allows.
+                std::terminate();
+            }
+
+            return next_record++;
+        }
+
+        /**
+         * Give a reader record back.
+         *
+         * @param index The reader record index.
+         */
+        void release(size_t index)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            free_records.push_back(index);
+        }
+
+        /** The reader records. */
+        std::array<Record, max_readers> records;
+
+        /** The current epoch, advanced by writers. */
+        alignas(64) std::atomic<uint64_t> global_epoch{1};
+
+        /** Protects the record allocation below. */
+        std::mutex mutex;
+
+        /** Records given back by exited threads. */
+        std::vector<size_t> free_records;
+
+        /** The next never used record. */
+        size_t next_record = 0;
+    };
+
+    #ifdef DELEGATE_MAX_READER_THREADS_UNDEF
+     #undef DELEGATE_MAX_READER_THREADS
+     #undef DELEGATE_MAX_READER_THREADS_UNDEF
+    #endif
+
+    /**
+     * Event with Delegate subscribers for emitting from many threads while subscribing and unsubscribing is rare.
+     * The subscribers are published as an immutable snapshot through an atomic pointer: emission loads the pointer
+     * and calls the snapshot's delegates without locking or writing shared memory, so it scales with the number of
+     * emitting threads.  Subscription changes copy the snapshot, swap it in under a lock, and free the old one once
+     * no emitter can still be reading it (see EpochDomain) - they are slow by design.
+     *
+     * Subscription changes made from within a subscriber (i.e. during emission) can't wait for emitters to finish,
+     * so the old snapshots are freed by a later change made outside of emission, or by the destructor.
+     *
+     * Example:
+     *      delegate::ConcurrentEvent<const Quote &> on_quote;
+     *      auto id = on_quote.subscribe([](const Quote &quote){...});
+     *      on_quote(quote);    // From any thread.
+     *      on_quote.unsubscribe(id);
+     *
+     * @tparam Arguments The subscriber function arguments.
+     */
+    template<typename... Arguments>
+    class ConcurrentEvent
+    {
+    public:
+        /** The subscriber delegate type. */
+        using Subscriber = Delegate<void, Arguments...>;
+
+        /** Identifies a subscription, for unsubscribing. */
+        using SubscriptionId = size_t;
+
+        /** Default constructor. */
+        ConcurrentEvent() = default;
+
+        /** Destructor. Emission must have stopped. */
+        ~ConcurrentEvent()
+        {
+            delete current.load();
+            for (const Snapshot *snapshot : retired)
+            {
+                delete snapshot;
+            }
+        }
+
+        /**
+         * Add a subscriber.
+         *
+         * @param subscriber The subscriber to add.
+         *
+         * @return Returns the subscription id.
+         */
+        SubscriptionId subscribe(Subscriber subscriber)
+        {
+            std::vector<const Snapshot *> to_free;
+            SubscriptionId id;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                id = next_id++;
+
+                Snapshot *snapshot = copy_current();
+                snapshot->entries.push_back({std::move(subscriber), id});
+                publish(snapshot, to_free);
+            }
+
+            reclaim(to_free);
+
+            return id;
+        }
+
+        /**
+         * Remove a subscriber.
+         *
+         * @param id The subscription id.
+         *
+         * @return Returns true if the subscriber was found, else false.
+         */
+        bool unsubscribe(SubscriptionId id)
+        {
+            std::vector<const Snapshot *> to_free;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                Snapshot *snapshot = copy_current();
+
+                auto found = std::find_if(snapshot->entries.begin(), snapshot->entries.end(),
+                                          [id](const Entry &entry){return entry.id == id;});
+                if (found == snapshot->entries.end())
+                {
+                    delete snapshot;
+                    return false;
+                }
+
+                snapshot->entries.erase(found);
+                publish(snapshot, to_free);
+            }
+
+            reclaim(to_free);
+
+            return true;
+        }
+
+        /**
+         * Call every subscriber in the current snapshot.  Safe to call from any number of threads at once.
+         *
+         * @param arguments The arguments to pass to each subscriber.
+         */
+        void operator()(Arguments... arguments) const
+        {
+            EpochDomain::ReadGuard guard;
+
+            const Snapshot *snapshot = current.load();
+            if (snapshot != nullptr)
+            {
+                for (const Entry &entry : snapshot->entries)
+                {
+                    entry.subscriber(arguments...);
+                }
+            }
+        }
+
+        /**
+         * Call every subscriber in the current snapshot, spread across a thread pool in contiguous chunks.  Events
+         * with fewer subscribers than the parallel threshold are emitted serially on the calling thread, as the
+         * hand-off costs more than it saves.  Subscribers are called concurrently, in no particular order.
+         *
+         * @param pool The thread pool to emit on.
+         * @param arguments The arguments to pass to each subscriber.
+         */
+        void emit_parallel(ThreadPool &pool, Arguments... arguments) const
+        {
+            EpochDomain::ReadGuard guard;
+
+            const Snapshot *snapshot = current.load();
+            if (snapshot == nullptr)
+            {
+                return;
+            }
+
+            const auto &entries = snapshot->entries;
+            if (entries.size() < parallel_threshold || pool.size() == 0)
+            {
+                for (const Entry &entry : entries)
+                {
+                    entry.subscriber(arguments...);
+                }
+
+                return;
+            }
+
+            // A few chunks per thread balances uneven subscribers, and whole cache lines of entries per chunk stop
+            // neighbouring chunks sharing lines.
+            constexpr size_t line_entries = line_size / std::gcd(line_size, sizeof(Entry));
+            const size_t parts = (pool.size() + 1) * 4;
+            size_t chunk = std::max(min_parallel_chunk, (entries.size() + parts - 1) / parts);
+            chunk = (chunk + line_entries - 1) / line_entries * line_entries;
+
+            std::tuple<Arguments &...> forwarded(arguments...);
+            pool.parallel_for(entries.size(), chunk, [&entries, &forwarded](size_t begin, size_t end)
+            {
+                for (size_t index = begin; index < end; index++)
+                {
+                    std::apply(entries[index].subscriber, forwarded);
+                }
+            });
+        }
+
+        /**
+         * Set the number of subscribers from which emit_parallel() spreads the subscribers across the thread pool.
+         *
+         * @param threshold The number of subscribers.
+         */
+        void set_parallel_threshold(size_t threshold)
+        {
+            parallel_threshold = threshold;
+        }
+
+        /**
+         * Returns the number of subscribers in the current snapshot.
+         *
+         * @return The number of subscribers.
+         */
+        size_t size() const
+        {
+            EpochDomain::ReadGuard guard;
+
+            const Snapshot *snapshot = current.load();
+            return snapshot == nullptr ? 0 : snapshot->entries.size();
+        }
+
+        ConcurrentEvent(const ConcurrentEvent &other) = delete;
+        ConcurrentEvent &operator=(const ConcurrentEvent &other) = delete;
+
+    private:
+        /** A subscriber. */
+        struct Entry
+        {
+            /** The subscriber. */
+            Subscriber subscriber;
+
+            /** The subscription id. */
+            SubscriptionId id;
+        };
+
+        /**
+         * Allocates the snapshot entries on cache line boundaries, so the whole lines of entries emit_parallel() hands
+         * to each chunk really are separate lines.
+         *
+         * @tparam T The allocated type.
+         */
+        template<typename T>
+        struct LineAllocator
+        {
+            using value_type = T;
+
+            LineAllocator() = default;
+
+            template<typename U>
+            LineAllocator(const LineAllocator<U> &)
+            {
+            }
+
+            T *allocate(size_t count)
+            {
+                return static_cast<T *>(::operator new(count * sizeof(T), std::align_val_t(line_size)));
+            }
+
+            void deallocate(T *pointer, size_t)
+            {
+                ::operator delete(pointer, std::align_val_t(line_size));
+            }
+
+            friend bool operator==(const LineAllocator &, const LineAllocator &)
+            {
+                return true;
+            }
+
+            friend bool operator!=(const LineAllocator &, const LineAllocator &)
+            {
+                return false;
+            }
+        };
+
+        /** An immutable (once published) list of subscribers. */
+        struct Snapshot
+        {
+            std::vector<Entry, LineAllocator<Entry>> entries;
+        };
+
+        /**
+         * Copy the current snapshot, for modifying.  Must hold the mutex.
+         *
+         * @return Returns the copy.
+         */
+        Snapshot *copy_current() const
+        {
+            const Snapshot *snapshot = current.load(std::memory_order_relaxed);
+
+            return snapshot == nullptr ? new Snapshot() : new Snapshot(*snapshot);
+        }
+
+        /**
+         * Publish a new snapshot, retiring the old one.  Must hold the mutex.
+         *
+         * @param snapshot The snapshot to publish.
+         * @param to_free Receives the retired snapshots to free (with reclaim(), after releasing the mutex), unless
+         *                an emitter on this thread may be reading them.
+         */
+        void publish(const Snapshot *snapshot, std::vector<const Snapshot *> &to_free)
+        {
+            const Snapshot *old = current.exchange(snapshot);
+            if (old != nullptr)
+            {
+                retired.push_back(old);
+            }
+
+            // Waiting for an emitter on this thread to finish would never end.
+            if (!EpochDomain::instance().reading())
+            {
+                to_free.swap(retired);
+            }
+        }
+
+        /**
+         * Free retired snapshots once no emitter can be reading them.  Waiting happens without holding the mutex, as
+         * the emitters waited for may themselves change subscriptions.
+         *
+         * @param to_free The snapshots to free.
+         */
+        static void reclaim(const std::vector<const Snapshot *> &to_free)
+        {
+            if (to_free.empty())
+            {
+                return;
+            }
+
+            EpochDomain::instance().synchronize();
+            for (const Snapshot *snapshot : to_free)
+            {
+                delete snapshot;
+            }
+        }
+
+        /** The cache line size the snapshot entries are aligned to. */
+        static constexpr size_t line_size = 64;
+
+        /** The smallest chunk of subscribers handed to a thread. */
+        static constexpr size_t min_parallel_chunk = 16;
+
+        /** The number of subscribers from which emit_parallel() uses the thread pool. */
+        size_t parallel_threshold = 1024;
+
+        /** The published snapshot, nullptr until the first subscription. */
+        std::atomic<const Snapshot *> current{nullptr};
+
+        /** Serializes subscription changes. */
+        std::mutex mutex;
+
+        /** Replaced snapshots not yet freed. */
+        std::vector<const Snapshot *> retired;
+
+        /** The id of the next subscription. */
+        SubscriptionId next_id = 0;
+    };
+}
@@ -0,0 +1,268 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <utility>
+#include "delegate.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+ #define DELEGATE_CPU_X86
+ #ifdef _MSC_VER
+  #include <intrin.h>
+ #else
+  #include <cpuid.h>
+ #endif
+#endif
+
+namespace delegate
+{
+    /** The environment variable which, if set to a number, replaces the detected CPU features (e.g. for testing). */
+    #ifndef DELEGATE_CPU_FEATURES_ENV
+     #define DELEGATE_CPU_FEATURES_ENV "DELEGATE_CPU_FEATURES"
+     #define DELEGATE_CPU_FEATURES_ENV_UNDEF
+    #endif
+
+    /** CPU features, combined into masks. */
+    enum CpuFeature : uint32_t
+    {
+        cpu_sse4_2 = 1 << 0,
+        cpu_popcnt = 1 << 1,
+        cpu_avx = 1 << 2,
+        cpu_avx2 = 1 << 3,
+        cpu_fma = 1 << 4,
+        cpu_bmi2 = 1 << 5,
+        cpu_avx512f = 1 << 6,
+        cpu_avx512bw = 1 << 7,
+        cpu_avx512vl = 1 << 8
+    };
+
+    /**
+     * Detect the features of the CPU, and whether the OS saves the registers they use.  If DELEGATE_CPU_FEATURES_ENV
+     * names an environment variable holding a number (e.g. "0x8"), that mask is returned instead - it can force a
+     * baseline variant, or any variant in tests, but forcing features the CPU lacks crashes real kernels.
+     *
+     * @return Returns the mask of CpuFeature.
+     */
+    inline uint32_t detect_cpu_features()
+    {
+        uint32_t features = 0;
+
+    #ifdef DELEGATE_CPU_X86
+        unsigned int leaf1[4] = {};
+        unsigned int leaf7[4] = {};
+        unsigned long long xcr0 = 0;
+     #ifdef _MSC_VER
+        int registers[4];
+        __cpuid(registers, 0);
+        const int max_leaf = registers[0];
+        __cpuidex(registers, 1, 0);
+        std::copy(registers, registers + 4, leaf1);
+        if (max_leaf >= 7)
+        {
+            __cpuidex(registers, 7, 0);
+            std::copy(registers, registers + 4, leaf7);
+        }
+     #else
+        __get_cpuid(1, &leaf1[0], &leaf1[1], &leaf1[2], &leaf1[3]);
+        __get_cpuid_count(7, 0, &leaf7[0], &leaf7[1], &leaf7[2], &leaf7[3]);
+     #endif
+
+        // The OS must save the AVX (and AVX-512) registers on context switches, as reported by XCR0.
+        if (leaf1[2] & (1u << 27))
+        {
+     #ifdef _MSC_VER
+            xcr0 = _xgetbv(0);
+     #else
+            unsigned int low;
+            unsigned int high;
+            __asm__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+            xcr0 = (static_cast<unsigned long long>(high) << 32) | low;
+     #endif
+        }
+        const bool avx_state = (xcr0 & 0x6) == 0x6;
+        const bool avx512_state = (xcr0 & 0xe6) == 0xe6;
+
+        const auto set = [&features](bool present, CpuFeature feature)
+        {
+            features |= present ? uint32_t(feature) : 0;
+        };
+        set(leaf1[2] & (1u << 20), cpu_sse4_2);
+        set(leaf1[2] & (1u << 23), cpu_popcnt);
+        set(avx_state && (leaf1[2] & (1u << 28)), cpu_avx);
+        set(avx_state && (leaf7[1] & (1u << 5)), cpu_avx2);
+        set(avx_state && (leaf1[2] & (1u << 12)), cpu_fma);
+        set(leaf7[1] & (1u << 8), cpu_bmi2);
+        set(avx512_state && (leaf7[1] & (1u << 16)), cpu_avx512f);
+        set(avx512_state && (leaf7[1] & (1u << 30)), cpu_avx512bw);
+        set(avx512_state && (leaf7[1] & (1u << 31)), cpu_avx512vl);
+    #endif
+
+        const char *forced = getenv(DELEGATE_CPU_FEATURES_ENV);
+        if (forced)
+        {
+            char *end;
+            const unsigned long mask = strtoul(forced, &end, 0);
+            features = end != forced && *end == '\0' ? uint32_t(mask) : features;
+        }
+
+        return features;
+    }
+
+    /**
+     * Returns the CPU features, detected on first use.
+     *
+     * @return Returns the mask of CpuFeature.
+     */
+    inline uint32_t cpu_features()
+    {
+        static const uint32_t features = detect_cpu_features();
+
+        return features;
+    }
+
+    /**
+     * Selects among variants of a kernel (e.g. SSE4.2, AVX2 and AVX-512 builds) by CPU features.  The variants are a
+     * fixed table, best first, and the table holds the best one the CPU supports in a delegate, so a call through
+     * the table is one delegate call with no feature check.  Variants are functions or capture-less lambdas, which
+     * delegates hold without storage.
+     *
+     * Selection happens on construction, so a table at namespace scope selects during static initialization, and a
+     * function local static table on first use.
+     *
+     * Example:
+     *      using Popcount = delegate::CpuDispatch<size_t, const uint64_t *, size_t>;
+     *      static Popcount::Table popcount({
+     *          {delegate::cpu_avx512f | delegate::cpu_avx512bw, &popcount_avx512},
+     *          {delegate::cpu_avx2, &popcount_avx2},
+     *          {0, &popcount_generic}});
+     *      popcount(words, count);
+     *
+     * @tparam Result The kernel return type.
+     * @tparam Arguments The kernel function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    class CpuDispatch
+    {
+    public:
+        /** The delegate type variants are held as. */
+        using DelegateType = Delegate<Result, Arguments...>;
+
+        /** A variant: the features it needs and its function. */
+        struct Variant
+        {
+            /** The mask of CpuFeature the variant needs. */
+            uint32_t features;
+
+            /** The variant. */
+            DelegateType delegate;
+        };
+
+        /**
+         * The variants of a kernel and the selected one.  The number of variants is deduced from the constructor
+         * argument.
+         *
+         * @tparam count The number of variants.
+         */
+        template<size_t count>
+        class Table
+        {
+        public:
+            static_assert(count > 0, "There must be at least one variant.");
+
+            /**
+             * Constructor.  Selects the best variant for the CPU.
+             *
+             * @param variants The variants, best first.  One must be supported, e.g. a last one needing no features.
+             */
+            explicit Table(const Variant (&variants)[count])
+            {
+                std::copy(variants, variants + count, table.begin());
+                select(cpu_features());
+            }
+
+            /**
+             * Select the best variant for a set of features.  Must not be called while the table may be called.
+             * Terminates if no variant is supported.
+             *
+             * @param features The mask of CpuFeature.
+             */
+            void select(uint32_t features)
+            {
+                for (selected_index = 0; selected_index < count; selected_index++)
+                {
+                    if ((table[selected_index].features & ~features) == 0)
+                    {
+                        selected = table[selected_index].delegate;
+                        return;
+                    }
+                }
+
+                // No supported variant.
+                std::terminate();
+            }
+
+            /**
+             * Call the selected variant.
+             *
+             * @param arguments The arguments to pass through to the variant.
+             *
+             * @return Returns the Result type.
+             */
+            Result operator()(Arguments... arguments) const
+            {
+                return selected(std::forward<Arguments>(arguments)...);
+            }
+
+            /**
+             * Returns the index of the selected variant.
+             *
+             * @return The index.
+             */
+            size_t index() const
+            {
+                return selected_index;
+            }
+
+        private:
+            /** The selected variant. */
+            DelegateType selected;
+
+            /** The index of the selected variant. */
+            size_t selected_index = 0;
+
+            /** The variants, best first. */
+            std::array<Variant, count> table;
+        };
+    };
+
+    #ifdef DELEGATE_CPU_FEATURES_ENV_UNDEF
+     #undef DELEGATE_CPU_FEATURES_ENV
+     #undef DELEGATE_CPU_FEATURES_ENV_UNDEF
+    #endif
+}
+
+#undef DELEGATE_CPU_X86
@@ -22,11 +22,14 @@
  * ** This comment block must remain in this and derived works.
  */
 #include <stdio.h>
+#include <string.h>
 #include <array>
 #include <type_traits>
 #include <utility>
 #include <new>
 #include <exception>
+#include <functional>
+#include <tuple>
 
 /**
  *                                                  ^^^ Rationale ^^^
@@ -115,6 +118,99 @@ namespace delegate
         return std::is_copy_constructible<T>::value;
     }
 
+    /**
+     * Determine whether the templated class needs no storage (e.g. a lambda without captures).  Delegates holding
+     * such functors don't construct anything in their storage, so they can be constant-initialized.
+     *
+     * @return Returns true if the class is stateless, else false.
+     */
+    template<typename T>
+    constexpr bool is_stateless()
+    {
+        return std::is_empty_v<T> && std::is_trivially_copyable_v<T>;
+    }
+
+    /**
+     * Whether two functors of this type are equal exactly when their bytes are equal, which makes delegates holding
+     * them comparable and hashable.  Defaults to types with unique object representations (no padding, no
+     * floating point), e.g. function pointers and lambdas capturing only pointers, or only integers of one size.
+     * Mixed captures usually have padding (an int and a pointer do on 64 bit targets), so they aren't bytewise
+     * comparable and, without an operator==, copies of them compare unequal.  Specialize this to opt other types in
+     * or out.
+     *
+     * @tparam T The functor type.
+     */
+    template<typename T>
+    struct is_bytewise_comparable : std::bool_constant<std::has_unique_object_representations_v<T>>
+    {
+    };
+
+    /** Determine whether the templated class has an operator==. */
+    template<typename T, typename = void>
+    struct has_equal_to : std::false_type
+    {
+    };
+
+    template<typename T>
+    struct has_equal_to<T, std::void_t<decltype(std::declval<const T &>() == std::declval<const T &>())>>
+        : std::true_type
+    {
+    };
+
+    /**
+     * Determine whether the templated class can be compared for equality when stored in a delegate.
+     *
+     * @return Returns true if the class is comparable, else false.
+     */
+    template<typename T>
+    constexpr bool can_compare()
+    {
+        return is_bytewise_comparable<T>::value || has_equal_to<T>::value || std::is_empty_v<T>;
+    }
+
+    /**
+     * Mix a value into a hash.
+     *
+     * @param seed The hash so far.
+     * @param value The value to mix in.
+     *
+     * @return Returns the new hash.
+     */
+    inline size_t hash_combine(size_t seed, size_t value)
+    {
+        return seed ^ (value + static_cast<size_t>(0x9e3779b97f4a7c15ull) + (seed << 6) + (seed >> 2));
+    }
+
+    /**
+     * Hash a (small) piece of memory a word at a time.
+     *
+     * @param data The memory to hash.
+     * @param size The number of bytes to hash.
+     *
+     * @return Returns the hash.
+     */
+    inline size_t hash_bytes(const void *data, size_t size)
+    {
+        const char *bytes = static_cast<const char *>(data);
+        size_t hash = size;
+
+        for (; size >= sizeof(size_t); size -= sizeof(size_t), bytes += sizeof(size_t))
+        {
+            size_t word;
+            memcpy(&word, bytes, sizeof(word));
+            hash = hash_combine(hash, word);
+        }
+
+        if (size > 0)
+        {
+            size_t word = 0;
+            memcpy(&word, bytes, size);
+            hash = hash_combine(hash, word);
+        }
+
+        return hash;
+    }
+
     /**
      * Reimbues a type-erased piece of memory with its original functor type.
      *
@@ -155,9 +251,26 @@ namespace delegate
         ::new (&get_typed_functor<T>(args)) T(std::move(to_move));
     }
 
+    /**
+     * Construct a functor directly into a piece of type-erased memory from its constructor arguments.
+     *
+     * @tparam T The functor type.
+     * @tparam CtorArguments The functor constructor argument types.
+     * @param args The memory to construct into.
+     * @param ctor_arguments The functor constructor arguments.
+     *
+     * @return Returns a reference to the constructed functor.
+     */
+    template<typename T, typename... CtorArguments>
+    static T &emplace_functor(FunctorArgs &args, CtorArguments&&... ctor_arguments)
+    {
+        return *::new (&get_typed_functor<T>(args)) T(std::forward<CtorArguments>(ctor_arguments)...);
+    }
+
     /**
      * Call the type-erased functor (with the correct type).  This is a pure forwarding function, only passing along
-     * arguments to the actual functor, i.e. a trampoline to call the real functor.
+     * arguments to the actual functor, i.e. a trampoline to call the real functor.  Inline rather than static, so
+     * every translation unit agrees on its address (delegates are constant-initialized with it, and compare it).
      * 
      * @tparam T The functor type.
      * @tparam Result The return type.
@@ -168,7 +281,7 @@ namespace delegate
      * @return The functor return type.
      */
     template<typename T, typename Result, typename... Arguments>
-    static Result typed_call(const FunctorArgs &args, Arguments&&... arguments)
+    inline Result typed_call(const FunctorArgs &args, Arguments&&... arguments)
     {
         return get_typed_functor<T>(args)(std::forward<Arguments>(arguments)...);
     }
@@ -177,6 +290,12 @@ namespace delegate
     template<typename Result, typename... Arguments>
     using func_call = Result (*)(const FunctorArgs &args, Arguments&&... arguments);
 
+    template<typename Result, typename... Arguments>
+    class FuncCopyable;
+
+    template<typename DelegateType, typename... HotFunctors>
+    class CallSite;
+
     /**
      * Manual virtual table implementation.  A virtual table is useful because there are multiple functions a full
      * delegate has beyond the call function (copy, move, deletion), and storing pointers for each type erased function
@@ -184,33 +303,96 @@ namespace delegate
      */
     struct Vtable
     {
+        /** Reference to the copy function. */
+        void (& copy)(FunctorArgs &lhs, const FunctorArgs &rhs);
+
+        /** Reference to the move function. */
+        void (& move)(FunctorArgs &lhs, FunctorArgs &&rhs);
+
+        /** Reference to the destroy function. */
+        void (& destroy)(FunctorArgs &args);
+
+        /** Reference to the equality function. */
+        bool (& equal)(const FunctorArgs &lhs, const FunctorArgs &rhs);
+
+        /** Reference to the hash function. */
+        size_t (& hash)(const FunctorArgs &args);
+
         /**
-         * Emits a full function static table pointer, unique to the template parameter.
+         * Returns the copy function of a functor type.  Stateless functors aren't constructed in the storage (see
+         * is_stateless), so their copy, move and destroy functions do nothing.
          *
-         * @tparam T The functor type associated with the virtual table.
+         * @tparam T The functor type.
+         *
+         * @return The copy function.
          */
         template<typename T>
-        inline static const Vtable &get_vtable()
+        static constexpr decltype(copy) get_copy()
         {
-            // Fill in the vtable for this type - the same type winds up with the same pointers for each.
-            static const Vtable vtable = 
+            if constexpr (is_stateless<T>())
+            {
+                return stateless_copy;
+            }
+            else
             {
-                typed_copy<T>,
-                typed_move<T>,
-                typed_destroy<T>
-            };
+                return typed_copy<T>;
+            }
+        }
 
-            return vtable;
+        /**
+         * Returns the move function of a functor type, see get_copy().
+         *
+         * @tparam T The functor type.
+         *
+         * @return The move function.
+         */
+        template<typename T>
+        static constexpr decltype(move) get_move()
+        {
+            if constexpr (is_stateless<T>())
+            {
+                return stateless_move;
+            }
+            else
+            {
+                return typed_move<T>;
+            }
         }
 
-        /** Reference to the copy function. */
-        void (& copy)(FunctorArgs &lhs, const FunctorArgs &rhs);
+        /**
+         * Returns the destroy function of a functor type, see get_copy().
+         *
+         * @tparam T The functor type.
+         *
+         * @return The destroy function.
+         */
+        template<typename T>
+        static constexpr decltype(destroy) get_destroy()
+        {
+            if constexpr (is_stateless<T>())
+            {
+                return stateless_destroy;
+            }
+            else
+            {
+                return typed_destroy<T>;
+            }
+        }
 
-        /** Reference to the move function. */
-        void (& move)(FunctorArgs &lhs, FunctorArgs &&rhs);
+        /** Copy of a stateless functor, which does nothing. */
+        static void stateless_copy(FunctorArgs &, const FunctorArgs &)
+        {
+        }
 
-        /** Reference to the destroy function. */
-        void (& destroy)(FunctorArgs &args);
+        /** Move of a stateless functor, which does nothing. */
+        static void stateless_move(FunctorArgs &, FunctorArgs &&)
+        {
+        }
+
+        /** Destroy of a stateless functor, which does nothing. */
+        static void stateless_destroy(FunctorArgs &)
+        {
+        }
 
         /**
          * Actual code to perform a copy.
@@ -269,8 +451,173 @@ namespace delegate
         {
             get_typed_functor<T>(args).~T();
         }
+
+        /**
+         * Actual code to perform an equality comparison.  Functors which can't be compared (see can_compare) are
+         * never equal.
+         *
+         * @tparam T The functor type to compare.
+         * @param lhs The memory of the first functor.
+         * @param rhs The memory of the second functor.
+         *
+         * @return True if the functors are equal, else false.
+         */
+        template<typename T>
+        static bool typed_equal(const FunctorArgs &lhs, const FunctorArgs &rhs)
+        {
+            if constexpr (is_bytewise_comparable<T>::value)
+            {
+                return memcmp(&get_typed_functor<T>(lhs), &get_typed_functor<T>(rhs), sizeof(T)) == 0;
+            }
+            else if constexpr (has_equal_to<T>::value)
+            {
+                return get_typed_functor<T>(lhs) == get_typed_functor<T>(rhs);
+            }
+            else
+            {
+                return std::is_empty_v<T>;
+            }
+        }
+
+        /**
+         * Actual code to perform a hash, consistent with typed_equal.  Functors compared with their own operator==
+         * are hashed with std::hash if it is available, else (like functors which can't be compared) not at all.
+         *
+         * @tparam T The functor type to hash.
+         * @param args The memory of the functor.
+         *
+         * @return The functor hash.
+         */
+        template<typename T>
+        static size_t typed_hash(const FunctorArgs &args)
+        {
+            if constexpr (is_bytewise_comparable<T>::value)
+            {
+                return hash_bytes(&get_typed_functor<T>(args), sizeof(T));
+            }
+            else if constexpr (has_equal_to<T>::value && std::is_default_constructible_v<std::hash<T>>)
+            {
+                return std::hash<T>()(get_typed_functor<T>(args));
+            }
+            else
+            {
+                return 0;
+            }
+        }
+    };
+
+    /**
+     * Extends the manual virtual table with the functions which depend on the delegate signature.  Each delegate
+     * signature gets its own table per functor type.
+     *
+     * @tparam Result The delegate return type.
+     * @tparam Arguments The delegate function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    struct CallVtable : Vtable
+    {
+        /**
+         * Returns the virtual table for a functor type, unique to the template parameter.  The table is a constant,
+         * so delegates can be constant-initialized with it.
+         *
+         * @tparam T The functor type associated with the virtual table.
+         *
+         * @return The virtual table.
+         */
+        template<typename T>
+        static constexpr const CallVtable &get_vtable();
+
+        /** Reference to the consuming call function (call, then destroy). */
+        Result (& consume)(FunctorArgs &args, Arguments&&... arguments);
+
+        /** Reference to the call function which discards the result, used when converting to a void delegate. */
+        void (& discard_call)(const FunctorArgs &args, Arguments&&... arguments);
+
+        /** Reference to the function returning the vtable to use with discard_call. */
+        const CallVtable<void, Arguments...> &(& discard_vtable)();
+
+        /**
+         * Actual code to perform a consuming call.  The functor is called as an rvalue when it supports it, so it may
+         * move its captures out, otherwise as an lvalue, and is destroyed once the call returns.
+         *
+         * @tparam T The functor type to call and destroy.
+         * @param args The memory of the functor type to call and destroy.
+         * @param arguments The functor arguments.
+         *
+         * @return The functor return type.
+         */
+        template<typename T>
+        static Result typed_consume(FunctorArgs &args, Arguments&&... arguments)
+        {
+            /** Destroys the functor after the call, including after the return value has been constructed. */
+            struct Destroyer
+            {
+                ~Destroyer()
+                {
+                    functor.~T();
+                }
+
+                T &functor;
+            } destroyer{get_typed_functor<T>(args)};
+
+            // Functors with an lvalue qualified call operator are called as an lvalue, then destroyed.
+            constexpr bool rvalue = std::is_invocable_v<T &&, Arguments...>;
+            using Functor = std::conditional_t<rvalue, T &&, T &>;
+
+            if constexpr (std::is_void_v<Result>)
+            {
+                static_cast<Functor>(destroyer.functor)(std::forward<Arguments>(arguments)...);
+            }
+            else
+            {
+                return static_cast<Functor>(destroyer.functor)(std::forward<Arguments>(arguments)...);
+            }
+        }
+
+        /**
+         * Actual code to perform a call which discards the functor's result.
+         *
+         * @tparam T The functor type to call.
+         * @param args The functor memory.
+         * @param arguments The functor arguments.
+         */
+        template<typename T>
+        static void typed_discard_call(const FunctorArgs &args, Arguments&&... arguments)
+        {
+            get_typed_functor<T>(args)(std::forward<Arguments>(arguments)...);
+        }
+    };
+
+    /**
+     * The virtual table of each functor type, per delegate signature.  An inline variable rather than a function
+     * static, so it's constant-initialized (with no guard) and the same type winds up with the same table everywhere.
+     *
+     * @tparam T The functor type.
+     * @tparam Result The delegate return type.
+     * @tparam Arguments The delegate function arguments.
+     */
+    template<typename T, typename Result, typename... Arguments>
+    inline constexpr CallVtable<Result, Arguments...> call_vtable =
+    {
+        {
+            Vtable::get_copy<T>(),
+            Vtable::get_move<T>(),
+            Vtable::get_destroy<T>(),
+            Vtable::typed_equal<T>,
+            Vtable::typed_hash<T>
+        },
+        CallVtable<Result, Arguments...>::template typed_consume<T>,
+        CallVtable<Result, Arguments...>::template typed_discard_call<T>,
+        CallVtable<void, Arguments...>::template get_vtable<T>
     };
 
+    template<typename Result, typename... Arguments>
+    template<typename T>
+    constexpr const CallVtable<Result, Arguments...> &CallVtable<Result, Arguments...>::get_vtable()
+    {
+        return call_vtable<T, Result, Arguments...>;
+    }
+
     /**
      * Base delegate - usable for the less common case of delegates with non-copyable captures.
      *
@@ -281,8 +628,27 @@ namespace delegate
     class FuncNonCopyable
     {
     public:
-        /** Default constructed delegates, like std::function, are legal but uncallable. */
-        inline static auto badcall = [](Arguments...) -> Result {std::terminate();};
+        /** The manual virtual table type for this delegate signature. */
+        using VtableType = CallVtable<Result, Arguments...>;
+
+        /** RTTI-free identity of a stored functor type (per delegate signature) - the address of its vtable. */
+        using TypeId = const Vtable *;
+
+        /**
+         * Default constructed delegates, like std::function, are legal but uncallable.  A named type rather than a
+         * lambda, as GCC gives the lambda's type internal linkage, and the empty state must be the same type in every
+         * translation unit.
+         */
+        struct BadCall
+        {
+            Result operator()(Arguments...) const
+            {
+                std::terminate();
+            }
+        };
+
+        /** The functor held by uncallable delegates. */
+        inline static BadCall badcall = {};
 
         /** Set the call function to be the right one for the type passed. */
         template<typename T>
@@ -305,7 +671,7 @@ namespace delegate
         template<typename T>
         void set_vtable_by_type(const T&)
         {
-            vtable = &Vtable::get_vtable<T>();
+            vtable = &VtableType::template get_vtable<T>();
         }
 
         /**
@@ -322,100 +688,382 @@ namespace delegate
         }
 
         /**
-         * Like std::function, returns whether it's safe to call this delegate.
-         * 
-         * @return True if the delegate is safe to call, else false.
+         * Returns whether the stored functor is of the passed in template parameter type.
+         *
+         * @tparam T The functor type to check against.
+         * @return True if the stored functor is a T, else false.
          */
-        explicit operator bool() const
-        {
-            return !check_same_call(typed_call<decltype(badcall), Result, Arguments...>);
-        }
-
-        /** Default constructor. Creates a valid (but uncallable) object. */
-        FuncNonCopyable()
-            : call(&typed_call<decltype(badcall), Result, Arguments...>)
-            , vtable(&Vtable::get_vtable<decltype(badcall)>())
+        template<typename T>
+        bool check_same_type() const
         {
+            return vtable == &VtableType::template get_vtable<T>();
         }
 
         /**
-         * Converting from functor move constructor.
+         * Returns the identity of the passed in template parameter functor type, for comparing against target_type().
          *
          * @tparam T The functor type.
-         * @param functor The functor to move.
+         * @return The functor type identity.
          */
         template<typename T>
-        explicit FuncNonCopyable(T &&functor) :
-            call(&typed_call<T, Result, Arguments...>),
-            vtable(&Vtable::get_vtable<T>())
+        static constexpr TypeId type_id()
         {
-            static_assert(can_emplace<T>(), "Delegate doesn't fit.");
-            static_assert(std::is_same_v<Result, std::invoke_result_t<T, Arguments...>>, "Wrong return type.");
-            move_functor(args, std::move(functor));
+            return &VtableType::template get_vtable<T>();
         }
 
         /**
-         * Move constructor.
+         * Like std::function, returns the identity of the stored functor type, without RTTI.  Uncallable delegates,
+         * including moved from ones, all return the identity of the empty state.
          *
-         * @param other The delegate to move from.
+         * @return The stored functor type identity.
          */
-        FuncNonCopyable(FuncNonCopyable &&other) 
-            : call(other.call)
-            , vtable(other.vtable)
+        TypeId target_type() const
         {
-            other.vtable->move(args, std::move(other.args));
-
-            /** Leave other in some well defined state. */
-            other.set_bad_call();
+            return vtable;
         }
 
         /**
-         * Functor move assignment operator.
+         * Like std::function, returns a pointer to the stored functor if it is of the passed in template parameter
+         * type.
          *
-         * @param other The delegate to move from.
+         * @tparam T The functor type to check against.
+         * @return A pointer to the stored functor, or nullptr if the stored functor is not a T.
          */
         template<typename T>
-        FuncNonCopyable &operator=(T &&functor)
+        T *target()
         {
-            static_assert(can_emplace<T>(), "Delegate doesn't fit.");
-            static_assert(std::is_same_v<Result, std::invoke_result_t<T, Arguments...>>, "Wrong return type.");
-
-            // Destroy whatever's currently stored before moving the parameter.
-            vtable->destroy(args);
-            move_functor(args, std::move(functor));
-
-            set_call_by_type<T>(functor);
-            set_vtable_by_type<T>(functor);
+            return check_same_type<T>() ? &get_typed_functor<T>(args) : nullptr;
+        }
 
-            return *this;
+        /**
+         * Like std::function, returns a pointer to the stored functor if it is of the passed in template parameter
+         * type.
+         *
+         * @tparam T The functor type to check against.
+         * @return A pointer to the stored functor, or nullptr if the stored functor is not a T.
+         */
+        template<typename T>
+        const T *target() const
+        {
+            return check_same_type<T>() ? &get_typed_functor<T>(args) : nullptr;
         }
 
         /**
-         * Move assignment operator.
-         * 
-         * @param other The delegate to move from.
-         * 
-         * @return Returns a reference to this.
+         * Returns whether two delegates hold equal functors: the same vtable (i.e. functor type) and equal captures.
+         * The call function isn't compared, as its address can differ between translation units.
+         * Captures are compared bytewise (see is_bytewise_comparable) or with their own operator==.  Captures which
+         * can't be compared are only equal to themselves, so a copy of such a delegate is unequal to the original.
+         * Uncallable delegates are equal to each other.
+         *
+         * @param other The delegate to compare against.
+         * @return True if the delegates are equal, else false.
          */
-        FuncNonCopyable &operator=(FuncNonCopyable &&other)
+        bool equals(const FuncNonCopyable &other) const
         {
-            if (&other == this)
+            if (!*this || !other)
             {
-                return *this;
+                return !*this && !other;
             }
 
-            vtable->destroy(args);
+            return this == &other || (vtable == other.vtable && vtable->equal(args, other.args));
+        }
+
+        /**
+         * Returns a hash of the vtable and captures, consistent with equals().
+         *
+         * @return The delegate hash.
+         */
+        size_t hash() const
+        {
+            if (!*this)
+            {
+                return 0;
+            }
+
+            return hash_combine(reinterpret_cast<size_t>(vtable), vtable->hash(args));
+        }
+
+        /**
+         * Delegate equality, see equals().
+         *
+         * @param lhs The first delegate.
+         * @param rhs The second delegate.
+         *
+         * @return True if the delegates are equal, else false.
+         */
+        friend bool operator==(const FuncNonCopyable &lhs, const FuncNonCopyable &rhs)
+        {
+            return lhs.equals(rhs);
+        }
+
+        /**
+         * Delegate inequality, see equals().
+         *
+         * @param lhs The first delegate.
+         * @param rhs The second delegate.
+         *
+         * @return True if the delegates are not equal, else false.
+         */
+        friend bool operator!=(const FuncNonCopyable &lhs, const FuncNonCopyable &rhs)
+        {
+            return !lhs.equals(rhs);
+        }
+
+        /**
+         * Like std::function, returns whether it's safe to call this delegate.
+         * 
+         * @return True if the delegate is safe to call, else false.
+         */
+        explicit operator bool() const
+        {
+            return !check_same_call(typed_call<decltype(badcall), Result, Arguments...>);
+        }
+
+        /** Default constructor. Creates a valid (but uncallable) object, constant-initialized. */
+        constexpr FuncNonCopyable()
+            : args()
+            , call(&typed_call<decltype(badcall), Result, Arguments...>)
+            , vtable(&VtableType::template get_vtable<decltype(badcall)>())
+        {
+        }
+
+        /**
+         * Converting from function pointer constructor.  Constant-initialized when the function is a constant.
+         *
+         * @param function The function to call.
+         */
+        constexpr explicit FuncNonCopyable(Result (*function)(Arguments...))
+            : function_pointer(function)
+            , call(&typed_call<Result (*)(Arguments...), Result, Arguments...>)
+            , vtable(&VtableType::template get_vtable<Result (*)(Arguments...)>())
+        {
+        }
+
+        /**
+         * Converting from functor move constructor.
+         *
+         * @tparam T The functor type.
+         * @param functor The functor to move.
+         */
+        template<typename T>
+        constexpr explicit FuncNonCopyable(T &&functor)
+            : FuncNonCopyable(&typed_call<std::decay_t<T>, Result, Arguments...>,
+                              &VtableType::template get_vtable<std::decay_t<T>>(),
+                              std::bool_constant<is_stateless<std::decay_t<T>>()>())
+        {
+            using Functor = std::decay_t<T>;
+            static_assert(can_emplace<Functor>(), "Delegate doesn't fit.");
+            static_assert(std::is_same_v<Result, std::invoke_result_t<Functor &, Arguments...>>, "Wrong return type.");
+            if constexpr (!is_stateless<Functor>())
+            {
+                emplace_functor<Functor>(args, std::forward<T>(functor));
+            }
+        }
+
+        /**
+         * In place constructor.  Constructs the functor directly in the delegate storage, avoiding the temporary (and
+         * its move) of the converting constructors.
+         *
+         * @tparam T The functor type.
+         * @tparam CtorArguments The functor constructor argument types.
+         * @param ctor_arguments The functor constructor arguments.
+         */
+        template<typename T, typename... CtorArguments>
+        explicit FuncNonCopyable(std::in_place_type_t<T>, CtorArguments&&... ctor_arguments) :
+            call(&typed_call<T, Result, Arguments...>),
+            vtable(&VtableType::template get_vtable<T>())
+        {
+            static_assert(can_emplace<T>(), "Delegate doesn't fit.");
+            static_assert(std::is_same_v<Result, std::invoke_result_t<T &, Arguments...>>, "Wrong return type.");
+            emplace_functor<T>(args, std::forward<CtorArguments>(ctor_arguments)...);
+        }
+
+        /**
+         * Move constructor.
+         *
+         * @param other The delegate to move from.
+         */
+        FuncNonCopyable(FuncNonCopyable &&other) noexcept
+            : call(other.call)
+            , vtable(other.vtable)
+        {
+            other.vtable->move(args, std::move(other.args));
+
+            // Destroy the moved from functor now (the destructor then has nothing to do), leaving other empty.
+            other.reset();
+        }
+
+        /**
+         * Converting move constructor from a copyable delegate of the same signature.  The functor is moved across
+         * rather than the copyable delegate being nested inside this one.
+         *
+         * @param other The delegate to move from.
+         */
+        FuncNonCopyable(FuncCopyable<Result, Arguments...> &&other) noexcept
+            : FuncNonCopyable(static_cast<FuncNonCopyable &&>(other))
+        {
+        }
+
+        /**
+         * Converting move constructor from a delegate whose result this (void) delegate discards.  The functor is
+         * moved across and called through a discarding trampoline, rather than the other delegate being nested.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to move from.
+         */
+        template<typename OtherResult, typename = std::enable_if_t<std::is_void_v<Result> &&
+                                                                   !std::is_void_v<OtherResult>>>
+        FuncNonCopyable(FuncNonCopyable<OtherResult, Arguments...> &&other) noexcept : FuncNonCopyable()
+        {
+            move_from(other);
+        }
+
+        /**
+         * Converting move constructor from a copyable delegate whose result this (void) delegate discards.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to move from.
+         */
+        template<typename OtherResult, typename = std::enable_if_t<std::is_void_v<Result> &&
+                                                                   !std::is_void_v<OtherResult>>>
+        FuncNonCopyable(FuncCopyable<OtherResult, Arguments...> &&other) noexcept
+            : FuncNonCopyable(static_cast<FuncNonCopyable<OtherResult, Arguments...> &&>(other))
+        {
+        }
+
+        /**
+         * Functor move assignment operator.
+         *
+         * @param other The delegate to move from.
+         */
+        template<typename T>
+        FuncNonCopyable &operator=(T &&functor)
+        {
+            using Functor = std::decay_t<T>;
+            static_assert(can_emplace<Functor>(), "Delegate doesn't fit.");
+            static_assert(std::is_same_v<Result, std::invoke_result_t<Functor &, Arguments...>>, "Wrong return type.");
+
+            // Reassigning the same functor type needs neither the vtable nor new call / vtable pointers.
+            if (check_same_type<Functor>())
+            {
+                Functor &stored = get_typed_functor<Functor>(args);
+                if constexpr (std::is_assignable_v<Functor &, T &&>)
+                {
+                    stored = std::forward<T>(functor);
+                }
+                else
+                {
+                    stored.~Functor();
+                    emplace_functor<Functor>(args, std::forward<T>(functor));
+                }
+
+                return *this;
+            }
+
+            // Destroy whatever's currently stored before moving the parameter.
+            vtable->destroy(args);
+            emplace_functor<Functor>(args, std::forward<T>(functor));
+
+            set_call_by_type<Functor>(functor);
+            set_vtable_by_type<Functor>(functor);
+
+            return *this;
+        }
+
+        /**
+         * Move assignment operator.
+         * 
+         * @param other The delegate to move from.
+         * 
+         * @return Returns a reference to this.
+         */
+        FuncNonCopyable &operator=(FuncNonCopyable &&other) noexcept
+        {
+            if (&other == this)
+            {
+                return *this;
+            }
+
+            vtable->destroy(args);
 
             other.vtable->move(args, std::move(other.args));
             this->call = other.call;
             this->vtable = other.vtable;
 
-            // Leave other in some well defined state.
-            other.set_bad_call();
+            // Destroy the moved from functor now (the destructor then has nothing to do), leaving other empty.
+            other.reset();
+
+            return *this;
+        }
+
+        /**
+         * Converting move assignment operator from a copyable delegate of the same signature.
+         *
+         * @param other The delegate to move from.
+         *
+         * @return Returns a reference to this.
+         */
+        FuncNonCopyable &operator=(FuncCopyable<Result, Arguments...> &&other) noexcept
+        {
+            return *this = static_cast<FuncNonCopyable &&>(other);
+        }
+
+        /**
+         * Converting move assignment operator from a delegate whose result this (void) delegate discards.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to move from.
+         *
+         * @return Returns a reference to this.
+         */
+        template<typename OtherResult, typename = std::enable_if_t<std::is_void_v<Result> &&
+                                                                   !std::is_void_v<OtherResult>>>
+        FuncNonCopyable &operator=(FuncNonCopyable<OtherResult, Arguments...> &&other) noexcept
+        {
+            reset();
+            move_from(other);
 
             return *this;
         }
 
+        /**
+         * Converting move assignment operator from a copyable delegate whose result this (void) delegate discards.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to move from.
+         *
+         * @return Returns a reference to this.
+         */
+        template<typename OtherResult, typename = std::enable_if_t<std::is_void_v<Result> &&
+                                                                   !std::is_void_v<OtherResult>>>
+        FuncNonCopyable &operator=(FuncCopyable<OtherResult, Arguments...> &&other) noexcept
+        {
+            return *this = static_cast<FuncNonCopyable<OtherResult, Arguments...> &&>(other);
+        }
+
+        /**
+         * Replace whatever's currently stored with a functor constructed directly in the delegate storage.
+         *
+         * @tparam T The functor type.
+         * @tparam CtorArguments The functor constructor argument types.
+         * @param ctor_arguments The functor constructor arguments.
+         *
+         * @return Returns a reference to the stored functor.
+         */
+        template<typename T, typename... CtorArguments>
+        T &emplace(CtorArguments&&... ctor_arguments)
+        {
+            static_assert(can_emplace<T>(), "Delegate doesn't fit.");
+            static_assert(std::is_same_v<Result, std::invoke_result_t<T &, Arguments...>>, "Wrong return type.");
+
+            vtable->destroy(args);
+            T &functor = emplace_functor<T>(args, std::forward<CtorArguments>(ctor_arguments)...);
+            set_call_by_type<T>(functor);
+            set_vtable_by_type<T>(functor);
+
+            return functor;
+        }
+
         /**
          * Forwarding function call operator.
          *
@@ -423,15 +1071,50 @@ namespace delegate
          *
          * @return Returns the Result type.
          */
-        Result operator()(Arguments... arguments) const
+        Result operator()(Arguments... arguments) const &
         {
             return call(args, std::forward<Arguments>(arguments)...);
         }
 
-        /** Destructor. */
+        /**
+         * Consuming function call operator.  Calls the functor as an rvalue (so it may move its captures out) and
+         * destroys it in the same trampoline, leaving this delegate uncallable.  The delegate must not be reassigned
+         * by the functor during the call.
+         *
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        Result operator()(Arguments... arguments) &&
+        {
+            auto &consume = vtable->consume;
+
+            // The functor is destroyed by the call, so leave this in the default state first.
+            set_bad_call();
+            set_vtable_by_type(badcall);
+
+            return consume(args, std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * Named form of the consuming function call operator, see operator()() &&.
+         *
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        Result invoke_and_reset(Arguments... arguments)
+        {
+            return std::move(*this)(std::forward<Arguments>(arguments)...);
+        }
+
+        /** Destructor.  Empty delegates (including consumed ones) have nothing to destroy, so skip the call. */
         ~FuncNonCopyable()
         {
-            vtable->destroy(args);
+            if (vtable != &VtableType::template get_vtable<decltype(badcall)>())
+            {
+                vtable->destroy(args);
+            }
         }
 
         /** These must be deleted to allow for non-copyable captures (like unique_ptr). */
@@ -443,24 +1126,130 @@ namespace delegate
         FuncNonCopyable &operator=(FuncNonCopyable &other) = delete;
 
     protected:
+        /** Delegates of other signatures, and copyable delegates, convert from this one. */
+        template<typename, typename...>
+        friend class FuncNonCopyable;
+        template<typename, typename...>
+        friend class FuncCopyable;
+        template<typename, typename...>
+        friend class CallSite;
+
         /**
          * Construct a new Func object with both the call and vtable set to the
          * passed in ones. Used by the CopyableType's copy constructors. 
          * 
-         * @tparam C The call type.
-         * @tparam V The vtable type.
          * @param call_type The call function to set.
          * @param vtable_type The vtable to set.
          */
-        template <typename C, typename V>
-        FuncNonCopyable(C call_type, V vtable_type)
+        FuncNonCopyable(func_call<Result, Arguments...> call_type, const VtableType *vtable_type)
             : call(call_type)
             , vtable(vtable_type)
         {
         }
 
-        /** The delegate arguments (function pointers and / or captures go here). */
-        FunctorArgs args;
+        /**
+         * As above, for functors about to be stored.  Stateless functors store nothing, so for those the storage is
+         * initialized here instead, and the delegate can be constant-initialized.
+         *
+         * @param call_type The call function to set.
+         * @param vtable_type The vtable to set.
+         */
+        constexpr FuncNonCopyable(func_call<Result, Arguments...> call_type, const VtableType *vtable_type,
+                                  std::true_type)
+            : args()
+            , call(call_type)
+            , vtable(vtable_type)
+        {
+        }
+
+        FuncNonCopyable(func_call<Result, Arguments...> call_type, const VtableType *vtable_type, std::false_type)
+            : FuncNonCopyable(call_type, vtable_type)
+        {
+        }
+
+        /**
+         * Take the call function and vtable from another delegate with the same arguments.  A delegate with a
+         * different result can only be adopted when this delegate's result is void, in which case the other
+         * delegate's discarding call function and vtable are used.  Nothing is adopted from an uncallable delegate
+         * of a different signature.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to take the call function and vtable from.
+         *
+         * @return True if the call function and vtable were adopted, else false.
+         */
+        template<typename OtherResult>
+        bool adopt_call(const FuncNonCopyable<OtherResult, Arguments...> &other)
+        {
+            if constexpr (std::is_same_v<Result, OtherResult>)
+            {
+                call = other.call;
+                vtable = other.vtable;
+            }
+            else
+            {
+                static_assert(std::is_void_v<Result>, "Only the result can be discarded.");
+                if (!other)
+                {
+                    return false;
+                }
+
+                call = &other.vtable->discard_call;
+                vtable = &other.vtable->discard_vtable();
+            }
+
+            return true;
+        }
+
+        /**
+         * Move another delegate's functor into this (default state) delegate, without nesting the other delegate.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to move from.
+         */
+        template<typename OtherResult>
+        void move_from(FuncNonCopyable<OtherResult, Arguments...> &other)
+        {
+            if (adopt_call(other))
+            {
+                other.vtable->move(args, std::move(other.args));
+
+                // Destroy the moved from functor now (the destructor then has nothing to do), leaving other empty.
+                other.reset();
+            }
+        }
+
+        /**
+         * Copy another delegate's functor into this (default state) delegate, without nesting the other delegate.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to copy from.
+         */
+        template<typename OtherResult>
+        void copy_from(const FuncNonCopyable<OtherResult, Arguments...> &other)
+        {
+            if (adopt_call(other))
+            {
+                other.vtable->copy(args, other.args);
+            }
+        }
+
+        /** Destroy whatever's currently stored, leaving this delegate in the default state. */
+        void reset()
+        {
+            vtable->destroy(args);
+            set_bad_call();
+            set_vtable_by_type(badcall);
+        }
+
+        union
+        {
+            /** The delegate arguments (function pointers and / or captures go here). */
+            FunctorArgs args;
+
+            /** The same storage as a function pointer, so function pointers can be stored in constant expressions. */
+            Result (*function_pointer)(Arguments...);
+        };
 
         /**
          * Trampoline function which reimbues the type-erased delgate with its original type and calls the functor.
@@ -472,7 +1261,7 @@ namespace delegate
          * Pointer to the manual virtual table.  This is statically constructed by the compiler or copied from another
          * value and cannot be null.
          */
-        const Vtable *vtable;
+        const VtableType *vtable;
     };
 
     /**
@@ -487,12 +1276,120 @@ namespace delegate
     public:
         /** Type used to bring forward the useful functions from the base class. */
         using FNC = FuncNonCopyable<Result, Arguments...>;
-        using FNC::operator();
+        using VtableType = typename FNC::VtableType;
         using FNC::operator bool;
+        using FNC::invoke_and_reset;
+        using FNC::check_same_type;
+        using FNC::type_id;
+        using FNC::target_type;
+        using FNC::target;
+        using typename FNC::TypeId;
+        using FNC::hash;
+
+        /**
+         * Forwarding function call operator.  Unlike MoveDelegate, it isn't consuming when called on an rvalue, since
+         * copyable delegates are often invoked through temporaries - use invoke_and_reset() to consume explicitly.
+         *
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        Result operator()(Arguments... arguments) const
+        {
+            return this->call(this->args, std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * Returns whether two delegates hold equal functors, see FuncNonCopyable::equals().
+         *
+         * @param other The delegate to compare against.
+         * @return True if the delegates are equal, else false.
+         */
+        bool equals(const FuncCopyable &other) const
+        {
+            return FNC::equals(other);
+        }
+
+        /**
+         * Delegate equality, see equals().
+         *
+         * @param lhs The first delegate.
+         * @param rhs The second delegate.
+         *
+         * @return True if the delegates are equal, else false.
+         */
+        friend bool operator==(const FuncCopyable &lhs, const FuncCopyable &rhs)
+        {
+            return lhs.equals(rhs);
+        }
+
+        /**
+         * Delegate inequality, see equals().
+         *
+         * @param lhs The first delegate.
+         * @param rhs The second delegate.
+         *
+         * @return True if the delegates are not equal, else false.
+         */
+        friend bool operator!=(const FuncCopyable &lhs, const FuncCopyable &rhs)
+        {
+            return !lhs.equals(rhs);
+        }
 
         /** Default constructor. Leave the object in an uninitialized state (see operator bool). */
-        FuncCopyable() : FNC()
+        constexpr FuncCopyable() : FNC()
+        {
+        }
+
+        /**
+         * Converting from function pointer constructor.  Constant-initialized when the function is a constant.
+         *
+         * @param function The function to call.
+         */
+        constexpr FuncCopyable(Result (*function)(Arguments...)) : FNC(function)
+        {
+        }
+
+        /**
+         * Restricts the forwarding functor overloads to rvalue functors which aren't themselves delegates, so that
+         * copying from a (non-const) delegate or functor lvalue still selects the copying overloads.
+         *
+         * @tparam T The forwarded functor type.
+         */
+        template<typename T>
+        using enable_if_rvalue_functor = std::enable_if_t<!std::is_lvalue_reference_v<T> &&
+                                                          !std::is_base_of_v<FNC, std::decay_t<T>>>;
+
+        /**
+         * In place constructor.  Constructs the functor directly in the delegate storage.
+         *
+         * @tparam T The functor type.
+         * @tparam CtorArguments The functor constructor argument types.
+         * @param in_place The functor type tag.
+         * @param ctor_arguments The functor constructor arguments.
+         */
+        template<typename T, typename... CtorArguments>
+        explicit FuncCopyable(std::in_place_type_t<T> in_place, CtorArguments&&... ctor_arguments)
+            : FNC(in_place, std::forward<CtorArguments>(ctor_arguments)...)
         {
+            static_assert(can_copy<T>(), "Object is non-copyable");
+        }
+
+        /**
+         * Replace whatever's currently stored with a functor constructed directly in the delegate storage.
+         *
+         * @tparam T The functor type.
+         * @tparam CtorArguments The functor constructor argument types.
+         * @param ctor_arguments The functor constructor arguments.
+         *
+         * @return Returns a reference to the stored functor.
+         */
+        template<typename T, typename... CtorArguments>
+        T &emplace(CtorArguments&&... ctor_arguments)
+        {
+            static_assert(can_copy<T>(), "Object is non-copyable");
+
+            return FNC::template emplace<T>(std::forward<CtorArguments>(ctor_arguments)...);
         }
     
         /**
@@ -504,10 +1401,38 @@ namespace delegate
          * @param functor The functor to move.
          */
         template<typename T>
-        FuncCopyable(const T& functor) : FNC(&typed_call<T, Result, Arguments...>, &Vtable::get_vtable<T>())
+        constexpr FuncCopyable(const T& functor)
+            : FNC(&typed_call<T, Result, Arguments...>, &VtableType::template get_vtable<T>(),
+                  std::bool_constant<is_stateless<T>()>())
         {
             static_assert(can_copy<T>(), "Object is non-copyable");
-            store_functor(this->args, functor);
+            if constexpr (!is_stateless<T>())
+            {
+                store_functor(this->args, functor);
+            }
+        }
+
+        /**
+         * Converting from rvalue functor constructor.  Moves the functor (e.g. a temporary lambda) into storage
+         * instead of copying its captures.
+         *
+         * @tparam T The functor type.
+         * @param functor The functor to move.
+         */
+        template<typename T, typename = enable_if_rvalue_functor<T>>
+        constexpr FuncCopyable(T &&functor)
+            : FNC(&typed_call<std::decay_t<T>, Result, Arguments...>,
+                  &VtableType::template get_vtable<std::decay_t<T>>(),
+                  std::bool_constant<is_stateless<std::decay_t<T>>()>())
+        {
+            using Functor = std::decay_t<T>;
+            static_assert(can_emplace<Functor>(), "Delegate doesn't fit.");
+            static_assert(std::is_same_v<Result, std::invoke_result_t<Functor &, Arguments...>>, "Wrong return type.");
+            static_assert(can_copy<Functor>(), "Object is non-copyable");
+            if constexpr (!is_stateless<Functor>())
+            {
+                emplace_functor<Functor>(this->args, std::forward<T>(functor));
+            }
         }
 
         /**
@@ -520,6 +1445,16 @@ namespace delegate
             this->vtable->copy(this->args, other.args);
         }
 
+        /**
+         * Move constructor.  Without this, moving a delegate would fall back to the copy constructor and deep copy the
+         * captures.  The cast selects the base move constructor rather than the base converting functor constructor.
+         *
+         * @param other The delegate to move from.
+         */
+        FuncCopyable(FuncCopyable &&other) noexcept : FNC(static_cast<FNC &&>(other))
+        {
+        }
+
         /**
          * Copy functor assignment operator.
          * 
@@ -531,9 +1466,28 @@ namespace delegate
         FuncCopyable &operator=(const T& functor)
         {
             static_assert(can_emplace<T>(), "Delegate doesn't fit.");
-            static_assert(std::is_same_v<Result, std::invoke_result_t<T, Arguments...>>, "Wrong return type.");
+            static_assert(std::is_same_v<Result, std::invoke_result_t<T &, Arguments...>>, "Wrong return type.");
             static_assert(can_copy<T>(), "Object is non-copyable");
 
+            // Reassigning the same functor type needs neither the vtable nor new call / vtable pointers.
+            if (FNC::template check_same_type<T>())
+            {
+                T &stored = get_typed_functor<T>(this->args);
+                if constexpr (std::is_copy_assignable_v<T>)
+                {
+                    stored = functor;
+                }
+                else if (&stored != &functor)
+                {
+                    stored.~T();
+                    store_functor(this->args, functor);
+                }
+
+                return *this;
+            }
+
+            // Destroy whatever's currently stored before copying the parameter.
+            this->vtable->destroy(this->args);
             store_functor(this->args, functor);
             FNC::template set_call_by_type<T>(functor);
             FNC::template set_vtable_by_type<T>(functor);
@@ -541,6 +1495,22 @@ namespace delegate
             return *this;
         }
 
+        /**
+         * Move functor assignment operator.
+         *
+         * @param functor The functor to move from.
+         *
+         * @return Returns a reference to this.
+         */
+        template<typename T, typename = enable_if_rvalue_functor<T>>
+        FuncCopyable &operator=(T &&functor)
+        {
+            static_assert(can_copy<std::decay_t<T>>(), "Object is non-copyable");
+            FNC::operator=(std::forward<T>(functor));
+
+            return *this;
+        }
+
         /**
          * Copy assignment operator.
          *
@@ -562,6 +1532,90 @@ namespace delegate
 
             return *this;
         }
+
+        /**
+         * Move assignment operator.
+         *
+         * @param other The delegate to move from.
+         *
+         * @return Returns a reference to this.
+         */
+        FuncCopyable &operator=(FuncCopyable &&other) noexcept
+        {
+            FNC::operator=(static_cast<FNC &&>(other));
+
+            return *this;
+        }
+
+        /** Restricts the converting overloads to delegates whose result this (void) delegate discards. */
+        template<typename OtherResult>
+        using enable_if_discarding = std::enable_if_t<std::is_void_v<Result> && !std::is_void_v<OtherResult>>;
+
+        /**
+         * Converting copy constructor from a delegate whose result this (void) delegate discards.  The functor is
+         * copied across and called through a discarding trampoline, rather than the other delegate being nested.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to copy from.
+         */
+        template<typename OtherResult, typename = enable_if_discarding<OtherResult>>
+        FuncCopyable(const FuncCopyable<OtherResult, Arguments...> &other) : FNC()
+        {
+            FNC::copy_from(static_cast<const FuncNonCopyable<OtherResult, Arguments...> &>(other));
+        }
+
+        /**
+         * Converting move constructor from a delegate whose result this (void) delegate discards.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to move from.
+         */
+        template<typename OtherResult, typename = enable_if_discarding<OtherResult>>
+        FuncCopyable(FuncCopyable<OtherResult, Arguments...> &&other) noexcept : FNC(std::move(other))
+        {
+        }
+
+        /**
+         * Converting copy assignment operator from a delegate whose result this (void) delegate discards.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to copy from.
+         *
+         * @return Returns a reference to this.
+         */
+        template<typename OtherResult, typename = enable_if_discarding<OtherResult>>
+        FuncCopyable &operator=(const FuncCopyable<OtherResult, Arguments...> &other)
+        {
+            FNC::reset();
+            FNC::copy_from(static_cast<const FuncNonCopyable<OtherResult, Arguments...> &>(other));
+
+            return *this;
+        }
+
+        /**
+         * Converting move assignment operator from a delegate whose result this (void) delegate discards.
+         *
+         * @tparam OtherResult The other delegate's return type.
+         * @param other The delegate to move from.
+         *
+         * @return Returns a reference to this.
+         */
+        template<typename OtherResult, typename = enable_if_discarding<OtherResult>>
+        FuncCopyable &operator=(FuncCopyable<OtherResult, Arguments...> &&other) noexcept
+        {
+            FNC::operator=(std::move(other));
+
+            return *this;
+        }
+
+    private:
+        /** Move delegates and delegates of other signatures convert from this one. */
+        template<typename, typename...>
+        friend class FuncNonCopyable;
+        template<typename, typename...>
+        friend class FuncCopyable;
+        template<typename, typename...>
+        friend class CallSite;
     };
 
     /** The following two are convenient names for the delegates. */
@@ -570,5 +1624,181 @@ namespace delegate
 
     template<typename Result, typename... Arguments>
     using Delegate = FuncCopyable<Result, Arguments...>;
+
+    /**
+     * Inline cache for a call site which mostly calls delegates holding one of a few known (hot) functor types.  The
+     * stored vtable (a single object for each functor type, whichever translation unit made the delegate) is
+     * compared against the hot types' vtables, and on a match the functor is called directly, which the compiler
+     * can inline.  Anything else falls back to the usual indirect call.  Hit and miss counts, and the trampolines
+     * behind the misses, are recorded to show whether the hot types are the right ones.
+     *
+     * Counters are plain integers - use one call site per thread.
+     *
+     * Example:
+     *      static delegate::CallSite<delegate::Delegate<void, int>, decltype(on_tick)> site;
+     *      site(handler, 17);
+     *
+     * @tparam DelegateType The delegate type called through this site.
+     * @tparam HotFunctors The functor types to call directly.
+     */
+    template<template<typename, typename...> class DelegateType, typename Result, typename... Arguments,
+             typename... HotFunctors>
+    class CallSite<DelegateType<Result, Arguments...>, HotFunctors...>
+    {
+    public:
+        /** Number of distinct missed trampolines remembered. */
+        static constexpr size_t observed_size = 4;
+
+        /** A trampoline seen on a miss and how often it was seen. */
+        struct Observed
+        {
+            func_call<Result, Arguments...> call;
+            size_t count;
+        };
+
+        /**
+         * Call the delegate, directly if it holds one of the hot functor types.
+         *
+         * @param delegate The delegate to call.
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        Result operator()(const DelegateType<Result, Arguments...> &delegate, Arguments... arguments)
+        {
+            return call_hot<0>(delegate, std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * Returns the number of direct calls made for a hot functor type.
+         *
+         * @tparam index The index of the functor type in HotFunctors.
+         * @return The number of direct calls.
+         */
+        template<size_t index>
+        size_t hits() const
+        {
+            return hit_counts[index];
+        }
+
+        /**
+         * Returns the number of calls which fell back to an indirect call.
+         *
+         * @return The number of indirect calls.
+         */
+        size_t misses() const
+        {
+            return miss_count;
+        }
+
+        /**
+         * Returns the trampolines seen on misses, in the order first seen.  Unused entries have a count of 0.
+         *
+         * @return The missed trampolines.
+         */
+        const std::array<Observed, observed_size> &observed() const
+        {
+            return observed_calls;
+        }
+
+        /** Reset all the counters. */
+        void reset_counts()
+        {
+            hit_counts = {};
+            miss_count = 0;
+            observed_calls = {};
+        }
+
+    private:
+        /**
+         * Check the delegate against the hot functor type at index, calling it directly on a match, else move on to
+         * the next type (and eventually the indirect call).
+         *
+         * @tparam index The index of the functor type in HotFunctors to check.
+         * @param delegate The delegate to call.
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        template<size_t index>
+        Result call_hot(const DelegateType<Result, Arguments...> &delegate, Arguments&&... arguments)
+        {
+            if constexpr (index == sizeof...(HotFunctors))
+            {
+                miss(delegate.call);
+                return delegate.call(delegate.args, std::forward<Arguments>(arguments)...);
+            }
+            else
+            {
+                using T = std::tuple_element_t<index, std::tuple<HotFunctors...>>;
+                if (delegate.vtable == &CallVtable<Result, Arguments...>::template get_vtable<T>())
+                {
+                    hit_counts[index]++;
+                    if constexpr (std::is_void_v<Result>)
+                    {
+                        // Void delegates may hold a functor with a result, to discard.
+                        get_typed_functor<T>(delegate.args)(std::forward<Arguments>(arguments)...);
+                        return;
+                    }
+                    else
+                    {
+                        return get_typed_functor<T>(delegate.args)(std::forward<Arguments>(arguments)...);
+                    }
+                }
+
+                return call_hot<index + 1>(delegate, std::forward<Arguments>(arguments)...);
+            }
+        }
+
+        /**
+         * Record a miss.
+         *
+         * @param call The trampoline which was called indirectly.
+         */
+        void miss(func_call<Result, Arguments...> call)
+        {
+            miss_count++;
+            for (Observed &observed : observed_calls)
+            {
+                if (observed.count == 0 || observed.call == call)
+                {
+                    observed.call = call;
+                    observed.count++;
+                    return;
+                }
+            }
+        }
+
+        /** Direct calls per hot functor type. */
+        std::array<size_t, sizeof...(HotFunctors)> hit_counts = {};
+
+        /** Indirect calls. */
+        size_t miss_count = 0;
+
+        /** Trampolines seen on misses. */
+        std::array<Observed, observed_size> observed_calls = {};
+    };
+}
+
+namespace std
+{
+    /** Delegates can be used as keys in unordered containers, see FuncNonCopyable::hash(). */
+    template<typename Result, typename... Arguments>
+    struct hash<delegate::FuncNonCopyable<Result, Arguments...>>
+    {
+        size_t operator()(const delegate::FuncNonCopyable<Result, Arguments...> &delegate) const
+        {
+            return delegate.hash();
+        }
+    };
+
+    template<typename Result, typename... Arguments>
+    struct hash<delegate::FuncCopyable<Result, Arguments...>>
+    {
+        size_t operator()(const delegate::FuncCopyable<Result, Arguments...> &delegate) const
+        {
+            return delegate.hash();
+        }
+    };
 }
 
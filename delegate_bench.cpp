@@ -0,0 +1,551 @@
+#include "delegate/batch_delegate.h"
+#include "delegate/c_callback.h"
+#include "delegate/concurrent_event.h"
+#include "delegate/journal.h"
+#include "delegate/lazy_delegate.h"
+#include "delegate/state_machine.h"
+#include "delegate/static_delegate.h"
+#include "delegate/string_dispatch.h"
+#ifdef __x86_64__
+#include "delegate/thunk_pool.h"
+#endif
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <string_view>
+#include <unordered_map>
+#include <unistd.h>
+#include <vector>
+
+/**
+ * Benchmarks, printed as tables.  Build with optimizations, e.g.
+ *      g++ -std=c++17 -O2 -I.. delegate_bench.cpp -lpthread -ldl
+ */
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Returns the average time of a repeated operation, in nanoseconds.
+     *
+     * @tparam T The operation type.
+     * @param operation The operation to time.
+     * @param min_time The minimum total time to run for.
+     *
+     * @return The average time per operation.
+     */
+    template<typename T>
+    double time_ns(T &&operation, std::chrono::milliseconds min_time = std::chrono::milliseconds(50))
+    {
+        operation();
+
+        size_t iterations = 0;
+        const Clock::time_point start = Clock::now();
+        Clock::duration elapsed;
+        do
+        {
+            operation();
+            iterations++;
+            elapsed = Clock::now() - start;
+        } while (elapsed < min_time);
+
+        return std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    }
+
+    /** Busy work standing in for a handler's cost. */
+    void spin(int work)
+    {
+        for (volatile int i = 0; i < work; i++)
+        {
+        }
+    }
+
+    /** Serial against parallel emission, by subscriber count and handler cost. */
+    void parallel_emit()
+    {
+        delegate::ThreadPool pool;
+        printf("Parallel emission (%zu worker threads + caller), microseconds per emission\n", pool.size());
+        printf("%12s %12s %12s %12s %10s\n", "handler spin", "subscribers", "serial", "parallel", "speedup");
+
+        for (int work : {0, 50, 500})
+        {
+            size_t crossover = 0;
+            for (size_t subscribers = 16; subscribers <= 16384; subscribers *= 4)
+            {
+                delegate::ConcurrentEvent<int> event;
+                event.set_parallel_threshold(0);
+                for (size_t subscriber = 0; subscriber < subscribers; subscriber++)
+                {
+                    event.subscribe([work](int){spin(work);});
+                }
+
+                const double serial = time_ns([&](){event(1);}) / 1000;
+                const double parallel = time_ns([&](){event.emit_parallel(pool, 1);}) / 1000;
+                if (crossover == 0 && parallel < serial * 0.9)
+                {
+                    crossover = subscribers;
+                }
+
+                printf("%12d %12zu %12.2f %12.2f %10.2f\n", work, subscribers, serial, parallel, serial / parallel);
+            }
+
+            printf("  crossover for handler spin %d: %s%zu subscribers\n\n", work, crossover ? "" : "> ",
+                   crossover ? crossover : size_t(16384));
+        }
+    }
+
+    /** A recorded task. */
+    struct JournalTask
+    {
+        int amount;
+
+        void operator()(int value) const
+        {
+            spin(amount + value);
+        }
+    };
+
+    /** Cost of recording to and replaying from a journal. */
+    void journal()
+    {
+        using Journal = delegate::Journal<void, int>;
+        constexpr int tasks = 1000000;
+        const char *path = "/tmp/delegate_bench.journal";
+        Journal::Registry::register_type<JournalTask>(1);
+
+        printf("Journal, nanoseconds per task (%d tasks)\n", tasks);
+        const delegate::Delegate<void, int> task(JournalTask{0});
+        double record;
+        {
+            Journal journal(path, tasks * 64);
+            const Clock::time_point start = Clock::now();
+            for (int value = 0; value < tasks; value++)
+            {
+                journal.record(task, 0);
+            }
+            record = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / tasks;
+        }
+
+        Journal::Replayer replayer(path);
+        const Clock::time_point start = Clock::now();
+        replayer.replay();
+        const double replay = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / tasks;
+        printf("%12s %12s\n%12.2f %12.2f\n\n", "record", "replay", record, replay);
+        unlink(path);
+    }
+
+    /** A session protocol, driven by both state machines below. */
+    struct Session
+    {
+        enum class State {idle, connecting, connected, count};
+        enum class Event {connect, ack, data, close, count};
+
+        long long received = 0;
+        int attempts = 0;
+    };
+
+    /** The equivalent hand-rolled state machine: std::function guards and actions in a hash map. */
+    class FunctionStateMachine
+    {
+    public:
+        using State = Session::State;
+        using Event = Session::Event;
+
+        void set(State from, Event event, State to, std::function<void(Session &, int)> action,
+                 std::function<bool(Session &, int)> guard)
+        {
+            transitions[key(from, event)] = Transition{std::move(guard), std::move(action), to};
+        }
+
+        bool dispatch(Event event, Session &session, int value)
+        {
+            const auto found = transitions.find(key(current, event));
+            if (found == transitions.end() || (found->second.guard && !found->second.guard(session, value)))
+            {
+                return false;
+            }
+
+            if (found->second.action)
+            {
+                found->second.action(session, value);
+            }
+            current = found->second.target;
+
+            return true;
+        }
+
+    private:
+        struct Transition
+        {
+            std::function<bool(Session &, int)> guard;
+            std::function<void(Session &, int)> action;
+            State target;
+        };
+
+        static unsigned key(State from, Event event)
+        {
+            return unsigned(from) << 8 | unsigned(event);
+        }
+
+        std::unordered_map<unsigned, Transition> transitions;
+        State current = State::idle;
+    };
+
+    /** State machine dispatch, table of delegates against a map of std::functions. */
+    void state_machine()
+    {
+        using State = Session::State;
+        using Event = Session::Event;
+        using Machine = delegate::StateMachine<State, Event, Session &, int>;
+
+        const auto can_connect = [](Session &session, int){return session.attempts < 1000000000;};
+        const auto on_connect = [](Session &session, int){session.attempts++;};
+        const auto on_data = [](Session &session, int bytes){session.received += bytes;};
+        const auto ignore = [](Session &, int){};
+        const Event events[] = {Event::connect, Event::ack, Event::data, Event::data, Event::data, Event::data,
+                                Event::ack, Event::close};
+
+        Machine::Table table;
+        table.set(State::idle, Event::connect, State::connecting, on_connect, can_connect);
+        table.set(State::connecting, Event::ack, State::connected);
+        table.set(State::connected, Event::data, State::connected, on_data);
+        table.set(State::connected, Event::close, State::idle);
+        Machine machine(table, State::idle);
+
+        FunctionStateMachine functions;
+        functions.set(State::idle, Event::connect, State::connecting, on_connect, can_connect);
+        functions.set(State::connecting, Event::ack, State::connected, ignore, nullptr);
+        functions.set(State::connected, Event::data, State::connected, on_data, nullptr);
+        functions.set(State::connected, Event::close, State::idle, ignore, nullptr);
+
+        Session session;
+        const double table_ns = time_ns([&]()
+        {
+            for (const Event event : events)
+            {
+                machine.dispatch(event, session, 1);
+            }
+        }) / std::size(events);
+        const double function_ns = time_ns([&]()
+        {
+            for (const Event event : events)
+            {
+                functions.dispatch(event, session, 1);
+            }
+        }) / std::size(events);
+
+        printf("State machine, million events per second\n");
+        printf("%16s %16s\n%16.1f %16.1f\n\n", "delegate table", "function map", 1000 / table_ns,
+               1000 / function_ns);
+    }
+
+    /** Message counts by type, updated by the string dispatch handlers. */
+    size_t message_counts[4];
+
+    /** Perfect hash string dispatch against a hash map and binary search, for FIX message types. */
+    void string_dispatch()
+    {
+        using Dispatch = delegate::StringDispatch<void, size_t>;
+        using Handler = delegate::Delegate<void, size_t>;
+
+        const auto count = [](size_t type){message_counts[type & 3]++;};
+        static constexpr Dispatch::Table table({
+            {"0", count}, {"1", count}, {"2", count}, {"3", count}, {"4", count}, {"5", count}, {"8", count},
+            {"9", count}, {"A", count}, {"D", count}, {"F", count}, {"G", count}, {"H", count}, {"j", count},
+            {"V", count}, {"W", count}, {"X", count}, {"Y", count}, {"AE", count}, {"AR", count}, {"BE", count},
+            {"BF", count}});
+        const std::string_view messages[] = {"D", "8", "8", "0", "F", "8", "AE", "G", "8", "D", "X", "W", "j", "Z"};
+
+        std::unordered_map<std::string_view, Handler> map;
+        std::vector<std::pair<std::string_view, Handler>> sorted;
+        for (const char *key : {"0", "1", "2", "3", "4", "5", "8", "9", "A", "D", "F", "G", "H", "j", "V", "W", "X",
+                                "Y", "AE", "AR", "BE", "BF"})
+        {
+            map.emplace(key, Handler(count));
+            sorted.emplace_back(key, Handler(count));
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const auto &lhs, const auto &rhs){return lhs.first < rhs.first;});
+
+        const double table_ns = time_ns([&]()
+        {
+            for (size_t message = 0; message < std::size(messages); message++)
+            {
+                if (const auto handler = table.find(messages[message]))
+                {
+                    handler(message);
+                }
+            }
+        }) / std::size(messages);
+        const double map_ns = time_ns([&]()
+        {
+            for (size_t message = 0; message < std::size(messages); message++)
+            {
+                const auto found = map.find(messages[message]);
+                if (found != map.end())
+                {
+                    found->second(message);
+                }
+            }
+        }) / std::size(messages);
+        const double sorted_ns = time_ns([&]()
+        {
+            for (size_t message = 0; message < std::size(messages); message++)
+            {
+                const auto found = std::lower_bound(sorted.begin(), sorted.end(), messages[message],
+                                                    [](const auto &entry, std::string_view key)
+                {
+                    return entry.first < key;
+                });
+                if (found != sorted.end() && found->first == messages[message])
+                {
+                    found->second(message);
+                }
+            }
+        }) / std::size(messages);
+
+        printf("String dispatch (%zu message types), nanoseconds per message\n", table.size());
+        printf("%16s %16s %16s\n%16.1f %16.1f %16.1f\n\n", "perfect hash", "hash map", "binary search", table_ns,
+               map_ns, sorted_ns);
+    }
+
+    /** The running total of the static delegate benchmark handlers. */
+    int handler_total;
+
+    /** Calls through a closed set of small handlers, inlined by StaticDelegate, against indirect delegate calls. */
+    void static_delegate()
+    {
+        const auto increment = [](int value){return value + 1;};
+        const auto twice = [](int value){return value * 2;};
+        const auto negate = [](int value){return -value;};
+        using Handler = delegate::Delegate<int, int>;
+        using StaticHandler = delegate::StaticDelegate<Handler, decltype(increment), decltype(twice), decltype(negate)>;
+
+        constexpr size_t count = 1024;
+        std::vector<Handler> handlers;
+        std::vector<StaticHandler> static_handlers;
+        for (size_t handler = 0; handler < count; handler++)
+        {
+            // Mostly one type, as at a typical call site, with a few others mixed in.
+            switch (handler % 8 == 0 ? handler / 8 % 3 : 0)
+            {
+            case 0:
+                handlers.emplace_back(increment);
+                static_handlers.emplace_back(increment);
+                break;
+            case 1:
+                handlers.emplace_back(twice);
+                static_handlers.emplace_back(twice);
+                break;
+            default:
+                handlers.emplace_back(negate);
+                static_handlers.emplace_back(negate);
+                break;
+            }
+        }
+
+        const double delegate_ns = time_ns([&]()
+        {
+            int total = handler_total;
+            for (const Handler &handler : handlers)
+            {
+                total = handler(total);
+            }
+            handler_total = total;
+        }) / count;
+        const double static_ns = time_ns([&]()
+        {
+            int total = handler_total;
+            for (const StaticHandler &handler : static_handlers)
+            {
+                total = handler(total);
+            }
+            handler_total = total;
+        }) / count;
+
+        printf("Static delegate (3 handler types), nanoseconds per call\n");
+        printf("%16s %16s\n%16.2f %16.2f\n\n", "delegate", "static delegate", delegate_ns, static_ns);
+    }
+
+    /** A feature transform over an array, per element through a delegate against one batch call. */
+    void batch_delegate()
+    {
+        const float scale = 0.5f;
+        const float offset = 3.0f;
+        const auto transform = [scale, offset](float value){return value * scale + offset;};
+        const delegate::Delegate<float, float> per_element = transform;
+        const delegate::BatchDelegate<float, float> batch = transform;
+
+        std::vector<float> in(1 << 16, 1.0f);
+        std::vector<float> out(in.size());
+        const double delegate_ns = time_ns([&]()
+        {
+            for (size_t index = 0; index < in.size(); index++)
+            {
+                out[index] = per_element(in[index]);
+            }
+        }) / in.size();
+        const double batch_ns = time_ns([&]()
+        {
+            batch.invoke_batch(in.data(), in.size(), out.data());
+        }) / in.size();
+
+        printf("Batch delegate (%zu floats), nanoseconds per element\n", in.size());
+        printf("%16s %16s\n%16.3f %16.3f\n\n", "per element", "batch", delegate_ns, batch_ns);
+    }
+
+    /** A C API taking a callback and its context, calling it for each value. */
+    __attribute__((noinline)) int c_sum(const int *values, size_t count, int (*callback)(void *, int), void *context)
+    {
+        int sum = 0;
+        for (size_t index = 0; index < count; index++)
+        {
+            sum += callback(context, values[index]);
+        }
+
+        return sum;
+    }
+
+    /** The running total of the C callback benchmark. */
+    int callback_total;
+
+    /** Registering a delegate as a C callback against a heap allocated std::function context. */
+    void c_callback()
+    {
+        const int values[] = {1, 2, 3, 4, 5, 6, 7, 8};
+        const int scale = 3;
+
+        const double function_ns = time_ns([&]()
+        {
+            auto *context = new std::function<int (int)>([scale](int value){return value * scale;});
+            callback_total += c_sum(values, std::size(values), [](void *context, int value)
+            {
+                return (*static_cast<std::function<int (int)> *>(context))(value);
+            }, context);
+            delete context;
+        });
+        const double delegate_ns = time_ns([&]()
+        {
+            const delegate::Delegate<int, int> scaled = [scale](int value){return value * scale;};
+            const auto callback = delegate::c_callback(scaled);
+            callback_total += c_sum(values, std::size(values), callback.function, callback.context);
+        });
+
+        printf("C callback (register, then %zu calls), nanoseconds per registration\n", std::size(values));
+        printf("%16s %16s\n%16.1f %16.1f\n\n", "std::function", "delegate", function_ns, delegate_ns);
+    }
+
+    /** Binding plugin entry points eagerly with dlsym against lazily, then calls through each. */
+    void lazy_delegate()
+    {
+        using EntryPoint = delegate::Delegate<int, int>;
+        const char *const names[] = {"abs", "toupper", "tolower", "isalpha", "isdigit", "isspace", "isupper",
+                                     "islower", "isalnum", "ispunct", "isxdigit", "isprint", "iscntrl", "isgraph",
+                                     "putchar", "toascii"};
+
+        const double eager_ns = time_ns([&]()
+        {
+            std::vector<EntryPoint> entry_points;
+            entry_points.reserve(std::size(names));
+            for (const char *name : names)
+            {
+                entry_points.emplace_back(reinterpret_cast<int (*)(int)>(dlsym(RTLD_DEFAULT, name)));
+            }
+            callback_total += int(entry_points.size());
+        }) / std::size(names);
+        const double lazy_ns = time_ns([&]()
+        {
+            std::deque<delegate::LazyDelegate<int, int>> entry_points;
+            for (const char *name : names)
+            {
+                entry_points.emplace_back(RTLD_DEFAULT, name);
+            }
+            callback_total += int(entry_points.size());
+        }) / std::size(names);
+
+        const EntryPoint eager(reinterpret_cast<int (*)(int)>(dlsym(RTLD_DEFAULT, "abs")));
+        const delegate::LazyDelegate<int, int> lazy(RTLD_DEFAULT, "abs");
+        const double eager_call_ns = time_ns([&]()
+        {
+            for (int value = 0; value < 64; value++)
+            {
+                callback_total += eager(-value);
+            }
+        }) / 64;
+        const double lazy_call_ns = time_ns([&]()
+        {
+            for (int value = 0; value < 64; value++)
+            {
+                callback_total += lazy(-value);
+            }
+        }) / 64;
+
+        printf("Lazy delegate, nanoseconds per entry point bound, then per call\n");
+        printf("%16s %16s %16s %16s\n%16.1f %16.1f %16.2f %16.2f\n\n", "eager bind", "lazy bind", "eager call",
+               "lazy call", eager_ns, lazy_ns, eager_call_ns, lazy_call_ns);
+    }
+
+#ifdef __x86_64__
+    /** A legacy API taking a bare function pointer, calling it for each value. */
+    __attribute__((noinline)) int legacy_sum(const int *values, size_t count, int (*callback)(int))
+    {
+        int sum = 0;
+        for (size_t index = 0; index < count; index++)
+        {
+            sum += callback(values[index]);
+        }
+
+        return sum;
+    }
+
+    /** Making and releasing thunks, and calls through a thunk against a delegate. */
+    void thunk_pool()
+    {
+        delegate::ThunkPool pool;
+        const int scale = 3;
+        const delegate::Delegate<int, int> scaled = [scale](int value){return value * scale;};
+        const int values[] = {1, 2, 3, 4, 5, 6, 7, 8};
+
+        const double make_ns = time_ns([&]()
+        {
+            const auto thunk = pool.make_thunk(scaled);
+            callback_total += thunk ? 1 : 0;
+        });
+
+        const auto thunk = pool.make_thunk(scaled);
+        const double thunk_ns = time_ns([&]()
+        {
+            callback_total += legacy_sum(values, std::size(values), thunk.function());
+        }) / std::size(values);
+        const auto callback = delegate::c_callback(scaled);
+        const double bridge_ns = time_ns([&]()
+        {
+            callback_total += c_sum(values, std::size(values), callback.function, callback.context);
+        }) / std::size(values);
+
+        printf("Thunk pool, nanoseconds per make and release, then per call\n");
+        printf("%16s %16s %16s\n%16.1f %16.2f %16.2f\n\n", "make + release", "thunk call", "context call", make_ns,
+               thunk_ns, bridge_ns);
+    }
+#endif
+}
+
+int main(int, char*[])
+{
+    parallel_emit();
+    journal();
+    state_machine();
+    string_dispatch();
+    static_delegate();
+    batch_delegate();
+    c_callback();
+    lazy_delegate();
+#ifdef __x86_64__
+    thunk_pool();
+#endif
+
+    return 0;
+}
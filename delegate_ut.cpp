@@ -1,6 +1,39 @@
 #define DELEGATE_ARGS_SIZE 24
 #define DELEGATE_ARGS_ALIGN 8
 #include "delegate/delegate.h"
+#include "delegate/batch_delegate.h"
+#include "delegate/c_callback.h"
+#include "delegate/concurrent_event.h"
+#include "delegate/cpu_dispatch.h"
+#include "delegate/ipc_queue.h"
+#include "delegate/memoized.h"
+#include "delegate/signal.h"
+#include "delegate/state_machine.h"
+#include "delegate/static_delegate.h"
+#include "delegate/string_dispatch.h"
+#include "delegate/delegate_ut_tu.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <queue>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#ifdef __linux__
+#include "delegate/handler_section.h"
+#include "delegate/journal.h"
+#include "delegate/lazy_delegate.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__x86_64__)
+#include "delegate/thunk_pool.h"
+#endif
 
 #ifdef WIN32
 #define DO_NOT_USE_WMAIN
@@ -105,6 +138,49 @@ public:
 int ClassFixture::construct_count = 0;
 int ClassFixture::destruct_count = 0;
 
+/** Counts copies, moves and assignments separately, so tests can tell a move from a silent deep copy. */
+class CopyMoveCounter
+{
+public:
+    static int copy_count;
+    static int move_count;
+    static int assign_count;
+
+    CopyMoveCounter() = default;
+
+    CopyMoveCounter(const CopyMoveCounter &)
+    {
+        copy_count++;
+    }
+
+    CopyMoveCounter(CopyMoveCounter &&) noexcept
+    {
+        move_count++;
+    }
+
+    CopyMoveCounter &operator=(const CopyMoveCounter &)
+    {
+        assign_count++;
+        return *this;
+    }
+
+    CopyMoveCounter &operator=(CopyMoveCounter &&) noexcept
+    {
+        assign_count++;
+        return *this;
+    }
+
+    static void reset_counts()
+    {
+        copy_count = 0;
+        move_count = 0;
+        assign_count = 0;
+    }
+};
+int CopyMoveCounter::copy_count = 0;
+int CopyMoveCounter::move_count = 0;
+int CopyMoveCounter::assign_count = 0;
+
 /** Test nove-only classes using smart pointers. */
 TEST_CASE("Smart pointers", "[smart_pointer]")
 {
@@ -383,6 +459,1715 @@ TEST_CASE("Construct / Destruct", "[construct_destruct]")
     }
 }
 
+/** Test that moving copyable delegates moves the captures rather than copying them. */
+TEST_CASE("Move Semantics", "[move_semantics]")
+{
+    static_assert(std::is_nothrow_move_constructible_v<delegate::Delegate<int, int>>, "Delegate move must be noexcept");
+    static_assert(std::is_nothrow_move_assignable_v<delegate::Delegate<int, int>>, "Delegate move must be noexcept");
+
+    CopyMoveCounter counter;
+    auto lambda = [counter](int i){return i + 1;};
+
+    SECTION("Move construct / assign")
+    {
+        delegate::Delegate<int, int> f = lambda;
+        CopyMoveCounter::reset_counts();
+
+        delegate::Delegate<int, int> moved(std::move(f));
+        REQUIRE(!!f == false);
+        REQUIRE(moved(1) == 2);
+
+        delegate::Delegate<int, int> assigned;
+        assigned = std::move(moved);
+        REQUIRE(!!moved == false);
+        REQUIRE(assigned(2) == 3);
+
+        REQUIRE(CopyMoveCounter::copy_count == 0);
+        REQUIRE(CopyMoveCounter::move_count == 2);
+    }
+    SECTION("Vector growth")
+    {
+        delegate::Delegate<int, int> f = lambda;
+        std::vector<delegate::Delegate<int, int>> delegates;
+        CopyMoveCounter::reset_counts();
+
+        for (int i = 0; i < 64; i++)
+        {
+            delegates.push_back(f);
+        }
+
+        // Only the explicit copies into the vector copy, reallocation moves.
+        REQUIRE(CopyMoveCounter::copy_count == 64);
+        REQUIRE(CopyMoveCounter::move_count > 0);
+        REQUIRE(delegates.back()(41) == 42);
+    }
+    SECTION("Queue round trip")
+    {
+        std::queue<delegate::Delegate<int, int>> queue;
+        CopyMoveCounter::reset_counts();
+
+        for (int i = 0; i < 16; i++)
+        {
+            delegate::Delegate<int, int> f = lambda;
+            queue.push(std::move(f));
+        }
+        REQUIRE(CopyMoveCounter::copy_count == 16);
+
+        int total = 0;
+        while (!queue.empty())
+        {
+            delegate::Delegate<int, int> f = std::move(queue.front());
+            queue.pop();
+            total += f(1);
+        }
+
+        REQUIRE(total == 32);
+        REQUIRE(CopyMoveCounter::copy_count == 16);
+        REQUIRE(CopyMoveCounter::move_count == 32);
+    }
+}
+
+/** Test that delegates constructed or assigned from temporary functors move them into storage. */
+TEST_CASE("Functor Forwarding", "[functor_forwarding]")
+{
+    SECTION("Construct from rvalue")
+    {
+        CopyMoveCounter counter;
+        CopyMoveCounter::reset_counts();
+
+        delegate::Delegate<int, int> f([counter](int i){return i * 2;});
+        REQUIRE(f(4) == 8);
+        REQUIRE(CopyMoveCounter::copy_count == 1);
+        REQUIRE(CopyMoveCounter::move_count == 1);
+    }
+    SECTION("Assign from rvalue")
+    {
+        CopyMoveCounter counter;
+        auto lambda = [counter](int i){return i * 3;};
+        delegate::Delegate<int, int> f;
+        CopyMoveCounter::reset_counts();
+
+        f = std::move(lambda);
+        REQUIRE(f(4) == 12);
+        REQUIRE(CopyMoveCounter::copy_count == 0);
+        REQUIRE(CopyMoveCounter::move_count == 1);
+    }
+    SECTION("Construct and assign from lvalue still copy")
+    {
+        CopyMoveCounter counter;
+        auto lambda = [counter](int i){return i * 4;};
+        CopyMoveCounter::reset_counts();
+
+        delegate::Delegate<int, int> f(lambda);
+        delegate::Delegate<int, int> f_copy(f);
+        delegate::Delegate<int, int> f_assign;
+        f_assign = f;
+
+        REQUIRE(f_copy(1) == 4);
+        REQUIRE(f_assign(2) == 8);
+        REQUIRE(!!f == true);
+        REQUIRE(CopyMoveCounter::copy_count == 3);
+        REQUIRE(CopyMoveCounter::move_count == 0);
+    }
+    SECTION("Const rvalue")
+    {
+        struct Half
+        {
+            float operator()(float value) const
+            {
+                return value / 2;
+            }
+        };
+        const Half half;
+
+        delegate::Delegate<float, float> f(std::move(half));
+        REQUIRE(f(3.0f) == 1.5f);
+        REQUIRE(f.target<Half>() != nullptr);
+        f = std::move(half);
+        REQUIRE(f(1.0f) == 0.5f);
+
+        delegate::MoveDelegate<float, float> move_only(std::move(half));
+        REQUIRE(move_only(5.0f) == 2.5f);
+    }
+    SECTION("Lvalue qualified call operator")
+    {
+        struct Counter
+        {
+            int operator()(int value) &
+            {
+                return total += value;
+            }
+
+            int total = 0;
+        };
+
+        delegate::Delegate<int, int> f(Counter{});
+        REQUIRE(f(2) == 2);
+        REQUIRE(f(3) == 5);
+        f = Counter{};
+        REQUIRE(f(1) == 1);
+
+        delegate::MoveDelegate<int, int> move_only(Counter{});
+        REQUIRE(move_only(4) == 4);
+        REQUIRE(std::move(move_only)(1) == 5);
+        REQUIRE(!!move_only == false);
+    }
+}
+
+/** A functor with an inline buffer, which is expensive to move. */
+struct InlineBufferFunctor
+{
+    InlineBufferFunctor(int base, char fill) : base(base)
+    {
+        for (char &c : buffer)
+        {
+            c = fill;
+        }
+    }
+
+    int operator()(int i) const
+    {
+        return base + i + buffer[0];
+    }
+
+    int base;
+    char buffer[16];
+    CopyMoveCounter counter;
+};
+
+/** Test constructing functors directly in the delegate storage. */
+TEST_CASE("Emplace", "[emplace]")
+{
+    SECTION("In place construct")
+    {
+        CopyMoveCounter::reset_counts();
+
+        delegate::Delegate<int, int> f(std::in_place_type<InlineBufferFunctor>, 100, 1);
+        delegate::MoveDelegate<int, int> m(std::in_place_type<InlineBufferFunctor>, 200, 2);
+        delegate::Delegate<int, int> f_trivial(std::in_place_type<int (*)(int)>, &StaticFixture::func_int_int);
+        REQUIRE(f(10) == 111);
+        REQUIRE(m(10) == 212);
+        REQUIRE(f_trivial(10) == 111);
+        REQUIRE(CopyMoveCounter::copy_count == 0);
+        REQUIRE(CopyMoveCounter::move_count == 0);
+    }
+    SECTION("Emplace")
+    {
+        ClassFixture::reset_counts();
+        {
+            ClassFixture fixture;
+            delegate::Delegate<int, int> f([fixture](int i){return i;});
+            delegate::MoveDelegate<int, int> m([fixture](int i){return i;});
+            CopyMoveCounter::reset_counts();
+            int destruct_count = ClassFixture::destruct_count;
+
+            InlineBufferFunctor &functor = f.emplace<InlineBufferFunctor>(300, 3);
+            m.emplace<InlineBufferFunctor>(400, 4);
+            REQUIRE(ClassFixture::destruct_count == destruct_count + 2);
+            REQUIRE(f(10) == 313);
+            REQUIRE(m(10) == 414);
+
+            functor.base = 500;
+            REQUIRE(f(10) == 513);
+            REQUIRE(CopyMoveCounter::copy_count == 0);
+            REQUIRE(CopyMoveCounter::move_count == 0);
+        }
+        REQUIRE(ClassFixture::construct_count == ClassFixture::destruct_count);
+    }
+}
+
+/** Test reassigning delegates from functors of the same and of different types. */
+TEST_CASE("Functor Reassignment", "[functor_reassignment]")
+{
+    SECTION("Same type assigns in place")
+    {
+        delegate::Delegate<int, int> f(std::in_place_type<InlineBufferFunctor>, 100, 0);
+        delegate::MoveDelegate<int, int> m(std::in_place_type<InlineBufferFunctor>, 100, 0);
+        InlineBufferFunctor functor(200, 0);
+        CopyMoveCounter::reset_counts();
+
+        f = functor;
+        REQUIRE(f(1) == 201);
+        f = InlineBufferFunctor(300, 0);
+        REQUIRE(f(1) == 301);
+        m = InlineBufferFunctor(400, 0);
+        REQUIRE(m(1) == 401);
+
+        REQUIRE(CopyMoveCounter::assign_count == 3);
+        REQUIRE(CopyMoveCounter::copy_count == 0);
+        REQUIRE(CopyMoveCounter::move_count == 0);
+    }
+    SECTION("Same non-assignable type reconstructs")
+    {
+        ClassFixture::reset_counts();
+        {
+            ClassFixture fixture;
+            auto make = [](const ClassFixture &fixture, int base)
+            {
+                return [fixture, base](int i){return base + i;};
+            };
+            delegate::Delegate<int, int> f = make(fixture, 1);
+            REQUIRE(f(1) == 2);
+
+            auto lambda = make(fixture, 2);
+            f = lambda;
+            REQUIRE(f(1) == 3);
+            f = make(fixture, 3);
+            REQUIRE(f(1) == 4);
+        }
+        REQUIRE(ClassFixture::construct_count == ClassFixture::destruct_count);
+    }
+    SECTION("Different type destroys once")
+    {
+        ClassFixture::reset_counts();
+        {
+            ClassFixture fixture;
+            auto lambda1 = [fixture](int i){return i + 1;};
+            auto lambda2 = [fixture](int i){return i + 2;};
+            delegate::Delegate<int, int> f = lambda1;
+            delegate::MoveDelegate<int, int> m(std::move(lambda1));
+            int destruct_count = ClassFixture::destruct_count;
+
+            f = lambda2;
+            REQUIRE(ClassFixture::destruct_count == destruct_count + 1);
+            REQUIRE(f(1) == 3);
+            m = std::move(lambda2);
+            REQUIRE(ClassFixture::destruct_count == destruct_count + 2);
+            REQUIRE(m(1) == 3);
+        }
+        REQUIRE(ClassFixture::construct_count == ClassFixture::destruct_count);
+    }
+}
+
+/** Test consuming invocation, which calls then destroys the functor and leaves the delegate empty. */
+TEST_CASE("Consuming Call", "[consuming_call]")
+{
+    SECTION("Destroys after call")
+    {
+        ClassFixture::reset_counts();
+        {
+            std::unique_ptr<ClassFixture> cf(new ClassFixture);
+            delegate::MoveDelegate<int, int> test([cf = std::move(cf)](int i)
+            {
+                REQUIRE(ClassFixture::destruct_count == 0);
+                return cf->func_int_int(i);
+            });
+
+            REQUIRE(std::move(test)(1234) == 1335);
+            REQUIRE(!!test == false);
+            REQUIRE(ClassFixture::destruct_count == 1);
+        }
+        REQUIRE(ClassFixture::construct_count == 1);
+        REQUIRE(ClassFixture::destruct_count == 1);
+    }
+    SECTION("Captures can be moved out")
+    {
+        std::vector<int> buffer = {1, 2, 3};
+        const int *data = buffer.data();
+        delegate::MoveDelegate<std::vector<int>> test([buffer = std::move(buffer)]() mutable
+        {
+            return std::move(buffer);
+        });
+
+        std::vector<int> stolen = test.invoke_and_reset();
+        REQUIRE(stolen.data() == data);
+        REQUIRE(stolen.size() == 3);
+        REQUIRE(!!test == false);
+    }
+    SECTION("Delegate is reusable after consuming")
+    {
+        ClassFixture::reset_counts();
+        {
+            ClassFixture fixture;
+            delegate::Delegate<void, int> f([fixture](int i) mutable {fixture.func_void_int(i);});
+            f.invoke_and_reset(1);
+            REQUIRE(!!f == false);
+            REQUIRE(ClassFixture::construct_count == ClassFixture::destruct_count + 1);
+
+            f = [fixture](int i) mutable {fixture.func_void_int(i);};
+            f(2);
+            REQUIRE(!!f == true);
+        }
+        REQUIRE(ClassFixture::construct_count == ClassFixture::destruct_count);
+    }
+    SECTION("Delegate rvalue call doesn't consume")
+    {
+        delegate::Delegate<int, int> f([](int i){return i + 1;});
+        REQUIRE(std::move(f)(1) == 2);
+        REQUIRE(!!f == true);
+        REQUIRE(delegate::Delegate<int, int>(f)(2) == 3);
+        REQUIRE(f(3) == 4);
+    }
+}
+
+/** Test conversions between delegate types, which move the functor across rather than nesting delegates. */
+TEST_CASE("Delegate Conversion", "[delegate_conversion]")
+{
+    SECTION("Delegate to MoveDelegate")
+    {
+        CopyMoveCounter counter;
+        delegate::Delegate<int, int> f([counter](int i){return i + 1;});
+        delegate::Delegate<int, int> g([counter](int i){return i + 2;});
+        CopyMoveCounter::reset_counts();
+
+        delegate::MoveDelegate<int, int> m(std::move(f));
+        REQUIRE(!!f == false);
+        REQUIRE(m(1) == 2);
+
+        m = std::move(g);
+        REQUIRE(!!g == false);
+        REQUIRE(m(1) == 3);
+
+        REQUIRE(CopyMoveCounter::copy_count == 0);
+        REQUIRE(CopyMoveCounter::move_count == 2);
+    }
+    SECTION("Discard result")
+    {
+        StaticFixture::init();
+        CopyMoveCounter counter;
+        delegate::Delegate<int, int> f([counter](int i){return StaticFixture::func_int_int(i);});
+        CopyMoveCounter::reset_counts();
+
+        delegate::Delegate<void, int> copied(f);
+        copied(1);
+        REQUIRE(StaticFixture::in == 1);
+        REQUIRE(!!f == true);
+
+        delegate::Delegate<void, int> assigned;
+        assigned = f;
+        assigned(2);
+        REQUIRE(StaticFixture::in == 2);
+
+        delegate::MoveDelegate<void, int> moved(std::move(f));
+        REQUIRE(!!f == false);
+        moved(3);
+        REQUIRE(StaticFixture::in == 3);
+        std::move(moved)(4);
+        REQUIRE(StaticFixture::in == 4);
+        REQUIRE(!!moved == false);
+
+        REQUIRE(CopyMoveCounter::copy_count == 2);
+        REQUIRE(CopyMoveCounter::move_count == 1);
+    }
+    SECTION("Discard result of uncallable delegate")
+    {
+        delegate::Delegate<int, int> f;
+        delegate::Delegate<void, int> g(f);
+        delegate::MoveDelegate<void, int> m(std::move(f));
+        REQUIRE(!!g == false);
+        REQUIRE(!!m == false);
+    }
+}
+
+/** Test querying the stored functor and its type without RTTI. */
+TEST_CASE("Target", "[target]")
+{
+    auto lambda1 = [](int i){return i + 1;};
+    auto lambda2 = [](int i){return i + 2;};
+    using IntInt = delegate::Delegate<int, int>;
+
+    SECTION("Uncallable")
+    {
+        const IntInt f;
+        REQUIRE(f.target<decltype(lambda1)>() == nullptr);
+        REQUIRE(f.target_type() != IntInt::type_id<decltype(lambda1)>());
+    }
+    SECTION("Functor")
+    {
+        IntInt f = lambda1;
+        const IntInt &const_f = f;
+        REQUIRE(f.target<decltype(lambda1)>() != nullptr);
+        REQUIRE(const_f.target<decltype(lambda1)>() != nullptr);
+        REQUIRE(f.target<decltype(lambda2)>() == nullptr);
+        REQUIRE((*f.target<decltype(lambda1)>())(1) == 2);
+        REQUIRE(f.check_same_type<decltype(lambda1)>());
+        REQUIRE(f.target_type() == IntInt::type_id<decltype(lambda1)>());
+        REQUIRE(f.target_type() != IntInt::type_id<decltype(lambda2)>());
+
+        IntInt g = f;
+        REQUIRE(g.target_type() == f.target_type());
+        g = lambda2;
+        REQUIRE(g.target_type() != f.target_type());
+    }
+    SECTION("Function pointer")
+    {
+        delegate::MoveDelegate<int, int> f(&StaticFixture::func_int_int);
+        REQUIRE(f.target<int (*)(int)>() != nullptr);
+        REQUIRE(*f.target<int (*)(int)>() == &StaticFixture::func_int_int);
+
+        *f.target<int (*)(int)>() = [](int i){return i;};
+        REQUIRE(f(5) == 5);
+    }
+    SECTION("Moved from")
+    {
+        const int offset = 3;
+        auto capturing = [offset](int i){return i + offset;};
+        using Functor = decltype(capturing);
+
+        IntInt f = capturing;
+        IntInt moved(std::move(f));
+        REQUIRE(!f);
+        REQUIRE(f.target<Functor>() == nullptr);
+        REQUIRE(!f.check_same_type<Functor>());
+        REQUIRE(f.target_type() == IntInt().target_type());
+        REQUIRE(moved.target<Functor>() != nullptr);
+
+        IntInt assigned;
+        assigned = std::move(moved);
+        REQUIRE(moved.target<Functor>() == nullptr);
+        REQUIRE(moved.target_type() == IntInt().target_type());
+        REQUIRE(assigned(1) == 4);
+
+        delegate::Delegate<void, int> discarding(std::move(assigned));
+        REQUIRE(assigned.target<Functor>() == nullptr);
+        REQUIRE(assigned.target_type() == IntInt().target_type());
+    }
+}
+
+/** Test the inline cache call site. */
+TEST_CASE("Call Site", "[call_site]")
+{
+    int total = 0;
+    auto hot1 = [&total](int i){total += i; return total;};
+    auto hot2 = [&total](int i){total += 2 * i; return total;};
+    auto cold = [&total](int i){total += 3 * i; return total;};
+
+    delegate::CallSite<delegate::Delegate<int, int>, decltype(hot1), decltype(hot2)> site;
+    delegate::Delegate<int, int> d1 = hot1;
+    delegate::Delegate<int, int> d2 = hot2;
+    delegate::Delegate<int, int> d3 = cold;
+
+    REQUIRE(site(d1, 1) == 1);
+    REQUIRE(site(d1, 1) == 2);
+    REQUIRE(site(d2, 1) == 4);
+    REQUIRE(site(d3, 1) == 7);
+    REQUIRE(site(d3, 1) == 10);
+    REQUIRE(site(&StaticFixture::func_int_int, 1) == 102);
+
+    REQUIRE(site.hits<0>() == 2);
+    REQUIRE(site.hits<1>() == 1);
+    REQUIRE(site.misses() == 3);
+    REQUIRE(site.observed()[0].count == 2);
+    REQUIRE(site.observed()[1].count == 1);
+    REQUIRE(site.observed()[2].count == 0);
+
+    delegate::CallSite<delegate::MoveDelegate<int, int>, decltype(hot1)> move_site;
+    delegate::MoveDelegate<int, int> m = std::move(d1);
+    REQUIRE(move_site(m, 10) == 20);
+    REQUIRE(move_site.hits<0>() == 1);
+
+    site.reset_counts();
+    REQUIRE(site.hits<0>() == 0);
+    REQUIRE(site.misses() == 0);
+}
+
+/** Test delegate equality and hashing. */
+TEST_CASE("Equality", "[equality]")
+{
+    using IntInt = delegate::Delegate<int, int>;
+
+    SECTION("Function pointers")
+    {
+        IntInt f1(&StaticFixture::func_int_int);
+        IntInt f2(&StaticFixture::func_int_int);
+        IntInt f3([](int i){return i;});
+        REQUIRE(f1 == f2);
+        REQUIRE(f1.hash() == f2.hash());
+        REQUIRE(f1 != f3);
+    }
+    SECTION("Bytewise comparable captures")
+    {
+        auto make = [](int *p){return [p](int i){return *p + i;};};
+        int a = 0;
+        int b = 0;
+        static_assert(delegate::is_bytewise_comparable<decltype(make(&a))>::value, "Pointer captures are bytewise");
+
+        IntInt fa1 = make(&a);
+        IntInt fa2 = make(&a);
+        IntInt fb = make(&b);
+        REQUIRE(fa1 == fa2);
+        REQUIRE(std::hash<IntInt>()(fa1) == std::hash<IntInt>()(fa2));
+        REQUIRE(fa1 != fb);
+
+        delegate::MoveDelegate<int, int> m1(make(&a));
+        delegate::MoveDelegate<int, int> m2(make(&a));
+        REQUIRE(m1 == m2);
+    }
+    SECTION("Non-comparable captures")
+    {
+        std::vector<int> v = {1, 2, 3};
+        IntInt f1([v](int i){return v[i];});
+        IntInt f2 = f1;
+        REQUIRE(f1 == f1);
+        REQUIRE(f1 != f2);
+    }
+    SECTION("Padded captures")
+    {
+        int a = 0;
+        int *p = &a;
+        int offset = 1;
+        auto padded = [p, offset](int i){return *p + offset + i;};
+        static_assert(sizeof(int *) == sizeof(int) || !delegate::is_bytewise_comparable<decltype(padded)>::value,
+                      "Padded captures aren't bytewise");
+
+        IntInt f1(padded);
+        IntInt f2 = f1;
+        REQUIRE(f1 == f1);
+        REQUIRE((f1 != f2) == (sizeof(int *) != sizeof(int)));
+    }
+    SECTION("Uncallable")
+    {
+        IntInt f1;
+        IntInt f2;
+        IntInt f3(&StaticFixture::func_int_int);
+        IntInt f4(std::move(f3));
+        REQUIRE(f1 == f2);
+        REQUIRE(f1 == f3);
+        REQUIRE(f1.hash() == f3.hash());
+        REQUIRE(f1 != f4);
+    }
+    SECTION("Dedupe")
+    {
+        int a = 0;
+        int b = 0;
+        auto make = [](int *p){return [p](int i){return *p + i;};};
+        std::unordered_set<IntInt> subscribers;
+        subscribers.insert(make(&a));
+        subscribers.insert(make(&b));
+        subscribers.insert(make(&a));
+        subscribers.insert(&StaticFixture::func_int_int);
+        subscribers.insert(&StaticFixture::func_int_int);
+        REQUIRE(subscribers.size() == 3);
+
+        subscribers.erase(make(&a));
+        REQUIRE(subscribers.size() == 2);
+    }
+}
+
+/** Test memoizing delegates. */
+TEST_CASE("Memoized", "[memoized]")
+{
+    static int calls = 0;
+    calls = 0;
+    auto price = [](int strike, int days){calls++; return strike * 1.5 + days;};
+
+    SECTION("Hits and misses")
+    {
+        delegate::Memoized<delegate::Delegate<double, int, int>, 16> memo(price);
+        REQUIRE(!!memo == true);
+        REQUIRE(memo(100, 5) == 155.0);
+        REQUIRE(memo(100, 5) == 155.0);
+        REQUIRE(memo(100, 6) == 156.0);
+        REQUIRE(memo(100, 5) == 155.0);
+
+        REQUIRE(calls == 2);
+        REQUIRE(memo.hits() == 2);
+        REQUIRE(memo.misses() == 2);
+
+        memo.clear();
+        REQUIRE(memo(100, 5) == 155.0);
+        REQUIRE(calls == 3);
+        REQUIRE(memo.hits() == 0);
+        REQUIRE(memo.misses() == 1);
+    }
+    SECTION("Eviction")
+    {
+        delegate::Memoized<delegate::Delegate<double, int, int>, 4> memo(price);
+        for (int i = 0; i < 64; i++)
+        {
+            REQUIRE(memo(i, i) == i * 2.5);
+        }
+        REQUIRE(calls == 64);
+
+        // A recently used entry survives eviction.
+        for (int i = 0; i < 64; i++)
+        {
+            REQUIRE(memo(1000, 1) == 1501.0);
+            REQUIRE(memo(i, 1000) == i * 1.5 + 1000);
+        }
+        REQUIRE(calls == 129);
+        REQUIRE(memo.hits() == 63);
+    }
+    SECTION("Move delegate")
+    {
+        std::unique_ptr<int> offset(new int(7));
+        delegate::MoveDelegate<int, int> m([offset = std::move(offset)](int i){calls++; return i + *offset;});
+        delegate::Memoized<delegate::MoveDelegate<int, int>, 2> memo(std::move(m));
+        REQUIRE(memo(1) == 8);
+        REQUIRE(memo(1) == 8);
+        REQUIRE(calls == 1);
+    }
+}
+
+/** Test signals and scoped connections. */
+TEST_CASE("Signal", "[signal]")
+{
+    using IntSignal = delegate::Signal<int>;
+    int total = 0;
+
+    SECTION("Connect / emit / scoped disconnect")
+    {
+        IntSignal signal;
+        IntSignal::Connection c1 = signal.connect([&total](int i){total += i;});
+        {
+            IntSignal::Connection c2 = signal.connect([&total](int i){total += 10 * i;});
+            REQUIRE(signal.size() == 2);
+            signal(1);
+            REQUIRE(total == 11);
+        }
+        REQUIRE(signal.size() == 1);
+        signal(1);
+        REQUIRE(total == 12);
+
+        IntSignal::Connection moved = std::move(c1);
+        REQUIRE(!c1.connected());
+        REQUIRE(moved.connected());
+        moved.disconnect();
+        REQUIRE(signal.empty());
+        signal(1);
+        REQUIRE(total == 12);
+    }
+    SECTION("Disconnect during emission")
+    {
+        IntSignal signal;
+        IntSignal::Connection c2;
+        IntSignal::Connection c1 = signal.connect([&](int i){total += i; c1.disconnect(); c2.disconnect();});
+        c2 = signal.connect([&total](int i){total += 10 * i;});
+        IntSignal::Connection c3 = signal.connect([&total](int i){total += 100 * i;});
+
+        signal(1);
+        REQUIRE(total == 101);
+        REQUIRE(signal.size() == 1);
+        signal(1);
+        REQUIRE(total == 201);
+    }
+    SECTION("Connect and emit during emission")
+    {
+        IntSignal signal;
+        std::vector<IntSignal::Connection> connections;
+        static int depth;
+        depth = 0;
+        connections.push_back(signal.connect([&](int i)
+        {
+            total += i;
+            if (depth++ == 0)
+            {
+                connections.push_back(signal.connect([&total](int i){total += 10 * i;}));
+                signal(2);
+            }
+        }));
+
+        signal(1);
+        REQUIRE(total == 3);
+        REQUIRE(signal.size() == 2);
+        signal(1);
+        REQUIRE(total == 14);
+    }
+    SECTION("Release and signal destruction")
+    {
+        IntSignal::Connection outlives;
+        {
+            IntSignal signal;
+            signal.connect([&total](int i){total += i;}).release();
+            outlives = signal.connect([&total](int i){total += 10 * i;});
+            signal(1);
+            REQUIRE(total == 11);
+            REQUIRE(signal.size() == 2);
+        }
+        REQUIRE(!outlives.connected());
+    }
+}
+
+/** Test the thread pool used for parallel emission. */
+TEST_CASE("Thread Pool", "[thread_pool]")
+{
+    delegate::ThreadPool pool(3);
+    REQUIRE(pool.size() == 3);
+
+    std::vector<int> values(1000, 0);
+    for (size_t chunk : {size_t(1), size_t(7), size_t(1000), size_t(5000)})
+    {
+        pool.parallel_for(values.size(), chunk, [&values](size_t begin, size_t end)
+        {
+            for (size_t index = begin; index < end; index++)
+            {
+                values[index]++;
+            }
+        });
+    }
+
+    for (int value : values)
+    {
+        REQUIRE(value == 4);
+    }
+
+    delegate::ThreadPool empty_pool(0);
+    empty_pool.parallel_for(10, 3, [&values](size_t begin, size_t end){values[begin] += int(end - begin);});
+    REQUIRE(values[0] == 7);
+    REQUIRE(values[9] == 5);
+}
+
+/** Test concurrent events, emitting from several threads while subscriptions change. */
+TEST_CASE("Concurrent Event", "[concurrent_event]")
+{
+    SECTION("Subscribe / unsubscribe")
+    {
+        delegate::ConcurrentEvent<int> event;
+        int total = 0;
+        event(1);
+
+        auto id1 = event.subscribe([&total](int i){total += i;});
+        auto id2 = event.subscribe([&total](int i){total += 10 * i;});
+        REQUIRE(event.size() == 2);
+        event(1);
+        REQUIRE(total == 11);
+
+        REQUIRE(event.unsubscribe(id1));
+        REQUIRE(!event.unsubscribe(id1));
+        event(1);
+        REQUIRE(total == 21);
+        REQUIRE(event.unsubscribe(id2));
+        REQUIRE(event.size() == 0);
+    }
+    SECTION("Subscribe during emission")
+    {
+        delegate::ConcurrentEvent<int> event;
+        int total = 0;
+        event.subscribe([&](int i)
+        {
+            total += i;
+            if (event.size() == 1)
+            {
+                event.subscribe([&total](int i){total += 10 * i;});
+            }
+        });
+
+        event(1);
+        REQUIRE(total == 1);
+        event(1);
+        REQUIRE(total == 12);
+    }
+    SECTION("Threads")
+    {
+        delegate::ConcurrentEvent<int> event;
+        std::atomic<int> total(0);
+        std::atomic<bool> stop(false);
+        event.subscribe([&total](int i){total += i;});
+
+        std::vector<std::thread> emitters;
+        for (int thread = 0; thread < 4; thread++)
+        {
+            emitters.emplace_back([&]()
+            {
+                while (!stop)
+                {
+                    event(1);
+                }
+            });
+        }
+
+        for (int i = 0; i < 200; i++)
+        {
+            auto id = event.subscribe([&total](int i){total += i;});
+            REQUIRE(event.unsubscribe(id));
+        }
+
+        while (total == 0)
+        {
+            std::this_thread::yield();
+        }
+
+        stop = true;
+        for (std::thread &emitter : emitters)
+        {
+            emitter.join();
+        }
+
+        REQUIRE(event.size() == 1);
+        REQUIRE(total > 0);
+    }
+    SECTION("Parallel emission")
+    {
+        delegate::ThreadPool pool(3);
+        delegate::ConcurrentEvent<int> event;
+        std::vector<std::atomic<int>> counts(1000);
+        for (std::atomic<int> &count : counts)
+        {
+            count = 0;
+            event.subscribe([&count](int i){count += i;});
+        }
+
+        event.set_parallel_threshold(100);
+        event.emit_parallel(pool, 1);
+        event.emit_parallel(pool, 2);
+        event.set_parallel_threshold(10000);
+        event.emit_parallel(pool, 3);
+
+        for (const std::atomic<int> &count : counts)
+        {
+            REQUIRE(count == 6);
+        }
+    }
+}
+
+/** A task with trivially copyable captures, which can be sent between processes. */
+struct AddTask
+{
+    int amount;
+
+    int operator()(int base) const
+    {
+        return base + amount;
+    }
+};
+
+/** Test passing delegates through a queue by stable type id. */
+TEST_CASE("IPC Queue", "[ipc_queue]")
+{
+    using Queue = delegate::IpcQueue<int, int>;
+    auto multiply = [](int factor){return [factor](int base){return base * factor;};};
+    Queue::Registry::register_type<AddTask>(1);
+    Queue::Registry::register_type<decltype(multiply(0))>(2);
+    REQUIRE(Queue::Registry::find(1) != nullptr);
+    REQUIRE(Queue::Registry::find(3) == nullptr);
+    REQUIRE(Queue::Registry::find(delegate::Delegate<int, int>(AddTask{1}))->id == 1);
+    REQUIRE(Queue::Registry::find(delegate::Delegate<int, int>(multiply(2)))->id == 2);
+    REQUIRE(Queue::Registry::find(delegate::Delegate<int, int>([](int base){return base;})) == nullptr);
+
+    SECTION("Single process")
+    {
+        alignas(64) static char memory[Queue::required_size(4)];
+        Queue queue = Queue::create(memory, 4);
+        delegate::Delegate<int, int> task;
+        REQUIRE(!queue.pop(task));
+
+        REQUIRE(queue.push(AddTask{5}));
+        REQUIRE(queue.push(multiply(3)));
+        REQUIRE(queue.push(delegate::Delegate<int, int>(AddTask{7})));
+        REQUIRE(queue.push(AddTask{9}));
+        REQUIRE(!queue.push(AddTask{11}));
+
+        Queue attached = Queue::attach(memory);
+        REQUIRE(attached.pop(task));
+        REQUIRE(task(1) == 6);
+        REQUIRE(attached.pop(task));
+        REQUIRE(task(2) == 6);
+        REQUIRE(task.target<decltype(multiply(0))>() != nullptr);
+        REQUIRE(queue.push(AddTask{11}));
+        REQUIRE(queue.pop(task));
+        REQUIRE(task(1) == 8);
+        REQUIRE(queue.pop(task));
+        REQUIRE(task(1) == 10);
+        REQUIRE(queue.pop(task));
+        REQUIRE(task(1) == 12);
+        REQUIRE(!queue.pop(task));
+    }
+#ifdef __linux__
+    SECTION("Two processes")
+    {
+        constexpr size_t capacity = 16;
+        constexpr int tasks = 1000;
+        const int fd = memfd_create("delegate_ipc_queue", 0);
+        REQUIRE(fd >= 0);
+        REQUIRE(ftruncate(fd, Queue::required_size(capacity)) == 0);
+        void *memory = mmap(nullptr, Queue::required_size(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        REQUIRE(memory != MAP_FAILED);
+        Queue queue = Queue::create(memory, capacity);
+
+        const pid_t child = fork();
+        REQUIRE(child >= 0);
+        if (child == 0)
+        {
+            // Map the queue again, at a different address, in the producer.
+            void *remapped = mmap(nullptr, Queue::required_size(capacity), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            Queue producer = Queue::attach(remapped);
+            for (int task = 0; task < tasks; task++)
+            {
+                while (!producer.push(AddTask{task}))
+                {
+                    sched_yield();
+                }
+            }
+            _exit(0);
+        }
+
+        long long total = 0;
+        delegate::Delegate<int, int> task;
+        for (int popped = 0; popped < tasks;)
+        {
+            if (queue.pop(task))
+            {
+                total += task(0);
+                popped++;
+            }
+            else
+            {
+                sched_yield();
+            }
+        }
+
+        int status = 0;
+        REQUIRE(waitpid(child, &status, 0) == child);
+        REQUIRE(WIFEXITED(status));
+        REQUIRE(total == tasks * (tasks - 1) / 2);
+        munmap(memory, Queue::required_size(capacity));
+        close(fd);
+    }
+#endif
+}
+
+/** A session driven by a state machine. */
+struct FsmSession
+{
+    enum class State {idle, connecting, connected, count};
+    enum class Event {connect, ack, data, close, count};
+    using Machine = delegate::StateMachine<State, Event, FsmSession &, int>;
+
+    int attempts = 0;
+    int received = 0;
+    bool allowed = true;
+};
+
+/** Test table-driven state machines. */
+TEST_CASE("State Machine", "[state_machine]")
+{
+    using State = FsmSession::State;
+    using Event = FsmSession::Event;
+    using Machine = FsmSession::Machine;
+
+    Machine::Table table;
+    table.set(State::idle, Event::connect, State::connecting, [](FsmSession &session, int){session.attempts++;},
+              [](FsmSession &session, int){return session.allowed;});
+    table.set(State::connecting, Event::ack, State::connected);
+    table.set(State::connected, Event::data, State::connected,
+              [](FsmSession &session, int bytes){session.received += bytes;});
+    table.set(State::connecting, Event::close, State::idle);
+    table.set(State::connected, Event::close, State::idle);
+
+    FsmSession first;
+    FsmSession second;
+    Machine first_machine(table, State::idle);
+    Machine second_machine(table, State::idle);
+
+    SECTION("Transitions")
+    {
+        REQUIRE(!first_machine.dispatch(Event::data, first, 10));
+        REQUIRE(first_machine.dispatch(Event::connect, first, 0));
+        REQUIRE(first_machine.state() == State::connecting);
+        REQUIRE(first.attempts == 1);
+        REQUIRE(first_machine.dispatch(Event::ack, first, 0));
+        REQUIRE(first_machine.dispatch(Event::data, first, 10));
+        REQUIRE(first_machine.dispatch(Event::data, first, 5));
+        REQUIRE(first.received == 15);
+        REQUIRE(first_machine.state() == State::connected);
+        REQUIRE(second_machine.state() == State::idle);
+        REQUIRE(first_machine.dispatch(Event::close, first, 0));
+        REQUIRE(first_machine.state() == State::idle);
+    }
+
+    SECTION("Guard")
+    {
+        second.allowed = false;
+        REQUIRE(!second_machine.dispatch(Event::connect, second, 0));
+        REQUIRE(second_machine.state() == State::idle);
+        REQUIRE(second.attempts == 0);
+        second.allowed = true;
+        REQUIRE(second_machine.dispatch(Event::connect, second, 0));
+        REQUIRE(second.attempts == 1);
+    }
+
+    SECTION("Clear")
+    {
+        table.clear(State::connected, Event::data);
+        first_machine.reset(State::connected);
+        REQUIRE(!first_machine.dispatch(Event::data, first, 10));
+        REQUIRE(first.received == 0);
+        REQUIRE(first_machine.state() == State::connected);
+    }
+}
+
+#ifdef __linux__
+/** A recorded task, identified by the thread that posted it. */
+struct JournalTask
+{
+    int thread;
+
+    void operator()(int sequence) const
+    {
+        replayed().emplace_back(thread, sequence);
+    }
+
+    static std::vector<std::pair<int, int>> &replayed()
+    {
+        static std::vector<std::pair<int, int>> replayed;
+        return replayed;
+    }
+};
+
+/** Test recording delegate invocations to a file and replaying them. */
+TEST_CASE("Journal", "[journal]")
+{
+    using Journal = delegate::Journal<void, int>;
+    Journal::Registry::register_type<JournalTask>(1);
+    const std::string path = "/tmp/delegate_ut_journal." + std::to_string(getpid());
+    JournalTask::replayed().clear();
+
+    SECTION("Threads")
+    {
+        constexpr int threads = 4;
+        constexpr int tasks = 5000;
+        {
+            Journal journal(path.c_str(), threads * (tasks * 64 + Journal::block_size));
+            REQUIRE(journal);
+
+            std::vector<std::thread> recorders;
+            for (int thread = 0; thread < threads; thread++)
+            {
+                recorders.emplace_back([&journal, thread]()
+                {
+                    const delegate::Delegate<void, int> task(JournalTask{thread});
+                    for (int sequence = 0; sequence < tasks; sequence++)
+                    {
+                        journal.record(task, sequence);
+                    }
+                });
+            }
+            for (std::thread &recorder : recorders)
+            {
+                recorder.join();
+            }
+            REQUIRE(journal.dropped() == 0);
+        }
+
+        Journal::Replayer replayer(path.c_str());
+        REQUIRE(replayer);
+        REQUIRE(replayer.size() == threads * tasks);
+        REQUIRE(replayer.replay() == threads * tasks);
+        REQUIRE(JournalTask::replayed().size() == threads * tasks);
+
+        std::vector<int> next(threads, 0);
+        bool ordered = true;
+        for (const std::pair<int, int> &task : JournalTask::replayed())
+        {
+            ordered = ordered && task.second == next[task.first]++;
+        }
+        REQUIRE(ordered);
+    }
+
+    SECTION("Full")
+    {
+        int recorded = 0;
+        {
+            Journal journal(path.c_str(), 1);
+            REQUIRE(journal);
+            for (int sequence = 0; sequence < 100000; sequence++)
+            {
+                recorded += journal.record(JournalTask{0}, sequence);
+            }
+            REQUIRE(recorded > 0);
+            REQUIRE(journal.dropped() == uint64_t(100000 - recorded));
+        }
+
+        Journal::Replayer replayer(path.c_str());
+        REQUIRE(replayer.replay() == size_t(recorded));
+        bool ordered = true;
+        for (size_t task = 0; task < JournalTask::replayed().size(); task++)
+        {
+            ordered = ordered && JournalTask::replayed()[task].second == int(task);
+        }
+        REQUIRE(ordered);
+    }
+
+    SECTION("Not a journal")
+    {
+        REQUIRE(!Journal::Replayer("/nonexistent/delegate_ut_journal"));
+        {
+            Journal journal(path.c_str(), 1);
+        }
+        REQUIRE(!delegate::Journal<void, long>::Replayer(path.c_str()));
+        Journal::Replayer empty(path.c_str());
+        REQUIRE(empty);
+        REQUIRE(empty.size() == 0);
+    }
+
+    unlink(path.c_str());
+}
+#endif
+
+#ifdef __cpp_constinit
+#define CONSTINIT constinit
+#else
+#define CONSTINIT
+#endif
+
+static int call_handlers();
+
+/** Initialized before the table below, so it would see zeroed delegates if the table were dynamically initialized. */
+static const int early_handler_result = call_handlers();
+
+/** A global handler table, constant-initialized so it's usable before (and during) dynamic initialization. */
+static int triple(int value)
+{
+    return 3 * value;
+}
+
+static CONSTINIT delegate::Delegate<int, int> handlers[] = {&triple, [](int value){return value + 1;}, {}};
+
+static int call_handlers()
+{
+    return handlers[0](2) + handlers[1](2);
+}
+
+/** Test constant initialization of delegates. */
+TEST_CASE("Constant Initialization", "[constant_initialization]")
+{
+    using Handler = delegate::Delegate<int, int>;
+    constexpr Handler::TypeId function_type = Handler::type_id<int (*)(int)>();
+
+    REQUIRE(early_handler_result == 9);
+    REQUIRE(handlers[0](5) == 15);
+    REQUIRE(handlers[1](5) == 6);
+    REQUIRE(!handlers[2]);
+    REQUIRE(handlers[0].target_type() == function_type);
+
+    delegate::Delegate<int, int> copy = handlers[1];
+    REQUIRE(copy(1) == 2);
+    REQUIRE(copy == handlers[1]);
+    handlers[2] = copy;
+    REQUIRE(handlers[2](2) == 3);
+    handlers[2] = delegate::Delegate<int, int>();
+}
+
+#ifdef __ELF__
+DELEGATE_HANDLER_SECTION(ut_commands, int, int);
+DELEGATE_HANDLER_SECTION(ut_no_commands, void);
+
+static int negate(int value)
+{
+    return -value;
+}
+
+DELEGATE_REGISTER_HANDLER(ut_commands, "negate", &negate);
+DELEGATE_REGISTER_HANDLER(ut_commands, "double", [](int value){return value * 2;});
+DELEGATE_REGISTER_HANDLER(ut_commands, "add", [](int value){return value + 1;});
+
+/** Test handlers registered in a linker section. */
+TEST_CASE("Handler Section", "[handler_section]")
+{
+    REQUIRE(ut_commands::size() == 3);
+    REQUIRE(ut_no_commands::size() == 0);
+    REQUIRE(ut_no_commands::find("negate") == nullptr);
+
+    int visited = 0;
+    ut_commands::for_each([&visited](const ut_commands::Record &record)
+    {
+        visited += record.function(1);
+    });
+    REQUIRE(visited == 3);
+
+    REQUIRE((*ut_commands::find("negate"))(4) == -4);
+    REQUIRE((*ut_commands::find("double"))(4) == 8);
+    REQUIRE((*ut_commands::find("add"))(4) == 5);
+    REQUIRE(ut_commands::find("subtract") == nullptr);
+    REQUIRE(ut_commands::find("") == nullptr);
+    REQUIRE(ut_commands::find("negate") == ut_commands::find(std::string("negate")));
+}
+#endif
+
+using UtDispatch = delegate::StringDispatch<int, int>;
+
+/** Built by the compiler, including the bucket displacements. */
+static constexpr UtDispatch::Table ut_dispatch({
+    {"negate", [](int value){return -value;}},
+    {"double", [](int value){return value * 2;}},
+    {"", [](int value){return value;}},
+    {"35", [](int value){return value + 35;}},
+    {"D", [](int value){return value + 68;}},
+    {"8", [](int value){return value + 8;}},
+    {"AE", [](int value){return value + 1;}},
+    {"BF", [](int value){return value + 2;}},
+    {"a", [](int value){return value + 97;}},
+    {"b", [](int value){return value + 98;}},
+    {"c", [](int value){return value + 99;}}});
+
+/** Test perfect hash string dispatch. */
+TEST_CASE("String Dispatch", "[string_dispatch]")
+{
+    static_assert(ut_dispatch.size() == 11, "The handler count is deduced.");
+
+    REQUIRE(ut_dispatch.find("negate")(4) == -4);
+    REQUIRE(ut_dispatch.find("double")(4) == 8);
+    REQUIRE(ut_dispatch.find("")(4) == 4);
+    REQUIRE(ut_dispatch.find("35")(0) == 35);
+    REQUIRE(ut_dispatch.find("D")(0) == 68);
+    REQUIRE(ut_dispatch.find("8")(0) == 8);
+    REQUIRE(ut_dispatch.find("AE")(0) == 1);
+    REQUIRE(ut_dispatch.find("BF")(0) == 2);
+    REQUIRE(ut_dispatch.find("a")(0) + ut_dispatch.find("b")(0) + ut_dispatch.find("c")(0) == 294);
+
+    REQUIRE(ut_dispatch.find("negat") == nullptr);
+    REQUIRE(ut_dispatch.find("negatee") == nullptr);
+    REQUIRE(ut_dispatch.find("d") == nullptr);
+    REQUIRE(ut_dispatch.find(std::string_view("double\0", 7)) == nullptr);
+    REQUIRE(ut_dispatch.find(std::string("negate")) == ut_dispatch.find("negate"));
+
+    const delegate::Delegate<int, int> handler(ut_dispatch.find("double"));
+    REQUIRE(handler(21) == 42);
+
+    static constexpr delegate::StringDispatch<void>::Table single({{"only", []{}}});
+    REQUIRE(single.find("only") != nullptr);
+    REQUIRE(single.find("") == nullptr);
+}
+
+/** Test delegates made in another translation unit. */
+TEST_CASE("Translation Units", "[translation_units]")
+{
+    delegate::Delegate<int, int> f;
+    REQUIRE(!!f == false);
+    REQUIRE(!OtherUnit::default_is_callable());
+
+    SECTION("Equality")
+    {
+        using IntInt = delegate::Delegate<int, int>;
+        const IntInt negate(&OtherUnit::negate);
+        REQUIRE(negate == OtherUnit::make_negate());
+        REQUIRE(negate.hash() == OtherUnit::make_negate().hash());
+
+        const IntInt add(OtherUnit::Add{2});
+        REQUIRE(add == OtherUnit::make_add(2));
+        REQUIRE(add.hash() == OtherUnit::make_add(2).hash());
+        REQUIRE(add != OtherUnit::make_add(3));
+
+        std::unordered_set<IntInt> subscribers;
+        subscribers.insert(add);
+        subscribers.insert(OtherUnit::make_add(2));
+        REQUIRE(subscribers.size() == 1);
+        REQUIRE(subscribers.erase(OtherUnit::make_add(2)) == 1);
+    }
+    SECTION("Call site")
+    {
+        delegate::CallSite<delegate::Delegate<int, int>, OtherUnit::Add> site;
+        const delegate::Delegate<int, int> add = OtherUnit::make_add(2);
+        REQUIRE(site(add, 1) == 3);
+        REQUIRE(site.hits<0>() == 1);
+        REQUIRE(site.misses() == 0);
+
+        delegate::CallSite<delegate::Delegate<void, int>, OtherUnit::Add> void_site;
+        const delegate::Delegate<void, int> discarding = add;
+        void_site(discarding, 1);
+        REQUIRE(void_site.hits<0>() == 1);
+    }
+}
+
+/** Test delegates over a closed set of functor types. */
+TEST_CASE("Static Delegate", "[static_delegate]")
+{
+    const auto increment = [](int value){return value + 1;};
+    auto share = std::make_shared<int>(10);
+    const auto add_shared = [share](int value){return value + *share;};
+    using Handler = delegate::StaticDelegate<delegate::Delegate<int, int>, decltype(increment), decltype(add_shared)>;
+
+    Handler empty;
+    REQUIRE(!empty);
+    REQUIRE(empty.index() == Handler::fallback);
+
+    Handler handler = increment;
+    REQUIRE(handler);
+    REQUIRE(handler.index() == 0);
+    REQUIRE(handler(1) == 2);
+    REQUIRE(handler.target<decltype(increment)>() != nullptr);
+    REQUIRE(handler.target<Handler::Fallback>() == nullptr);
+    const Handler &constant = handler;
+    REQUIRE(constant.target<decltype(increment)>() == handler.target<decltype(increment)>());
+    REQUIRE(constant.target<decltype(add_shared)>() == nullptr);
+    static_assert(std::is_nothrow_move_constructible_v<Handler>, "Moves don't throw");
+    static_assert(std::is_nothrow_move_assignable_v<Handler>, "Moves don't throw");
+
+    SECTION("Fallback")
+    {
+        const int offset = 5;
+        Handler fallback = [offset](int value){return value * offset;};
+        REQUIRE(fallback.index() == Handler::fallback);
+        REQUIRE(fallback(2) == 10);
+        REQUIRE(fallback.target<Handler::Fallback>() != nullptr);
+
+        Handler pointer = static_cast<int (*)(int)>([](int value){return -value;});
+        REQUIRE(pointer.index() == Handler::fallback);
+        REQUIRE(pointer(3) == -3);
+
+        handler = fallback;
+        REQUIRE(handler.index() == Handler::fallback);
+        REQUIRE(handler(3) == 15);
+        REQUIRE(fallback(3) == 15);
+    }
+
+    SECTION("Lifetime")
+    {
+        {
+            Handler shared = add_shared;
+            REQUIRE(shared.index() == 1);
+            REQUIRE(share.use_count() == 3);
+            REQUIRE(shared(1) == 11);
+
+            Handler copy = shared;
+            REQUIRE(share.use_count() == 4);
+            REQUIRE(copy(2) == 12);
+
+            Handler moved = std::move(copy);
+            REQUIRE(moved(3) == 13);
+
+            handler = moved;
+            REQUIRE(share.use_count() == 5);
+            REQUIRE(handler(4) == 14);
+
+            moved = increment;
+            REQUIRE(share.use_count() == 4);
+            REQUIRE(moved(4) == 5);
+        }
+        REQUIRE(share.use_count() == 3);
+
+        handler = Handler();
+        REQUIRE(share.use_count() == 2);
+        REQUIRE(!handler);
+    }
+}
+
+/** Test per-element functors called over arrays. */
+TEST_CASE("Batch Delegate", "[batch_delegate]")
+{
+    std::vector<float> in(37);
+    for (size_t index = 0; index < in.size(); index++)
+    {
+        in[index] = float(index);
+    }
+    std::vector<float> out(in.size());
+
+    const float scale = 2.5f;
+    delegate::BatchDelegate<float, float> scaled = [scale](float value){return value * scale;};
+    REQUIRE(scaled);
+    REQUIRE(scaled(2.0f) == 5.0f);
+    scaled.invoke_batch(in.data(), in.size(), out.data());
+    REQUIRE(out[0] == 0.0f);
+    REQUIRE(out[36] == 90.0f);
+
+    SECTION("In Place")
+    {
+        scaled.invoke_batch(in.data(), in.size(), in.data());
+        REQUIRE(in[1] == 2.5f);
+        REQUIRE(in[36] == 90.0f);
+    }
+
+    SECTION("Mutable")
+    {
+        delegate::BatchDelegate<float, float> running = [total = 0.0f](float value) mutable
+        {
+            return total += value;
+        };
+        running.invoke_batch(in.data(), 4, out.data());
+        REQUIRE(out[3] == 6.0f);
+        running.invoke_batch(in.data(), 1, out.data());
+        REQUIRE(out[0] == 6.0f);
+        REQUIRE(running(1.0f) == 7.0f);
+    }
+
+    SECTION("Const and moved functors")
+    {
+        struct Offset
+        {
+            float operator()(float value) const
+            {
+                return value + offset;
+            }
+
+            float offset;
+        };
+
+        const Offset constant{1.0f};
+        delegate::BatchDelegate<float, float> from_const(std::move(constant));
+        from_const.invoke_batch(in.data(), in.size(), out.data());
+        REQUIRE(out[36] == 37.0f);
+
+        Offset moved{2.0f};
+        delegate::BatchDelegate<float, float> from_moved(std::move(moved));
+        from_moved.invoke_batch(in.data(), in.size(), out.data());
+        REQUIRE(out[36] == 38.0f);
+        REQUIRE(from_moved.get_delegate().target<Offset>() != nullptr);
+
+        delegate::BatchDelegate<float, float> taken(std::move(from_moved));
+        REQUIRE(!from_moved);
+        REQUIRE(from_moved.get_delegate().target<Offset>() == nullptr);
+        taken.invoke_batch(in.data(), in.size(), out.data());
+        REQUIRE(out[36] == 38.0f);
+    }
+
+    SECTION("Delegate")
+    {
+        const delegate::Delegate<float, float> negate = [](float value){return -value;};
+        delegate::BatchDelegate<float, float> from_delegate = negate;
+        from_delegate.invoke_batch(in.data(), in.size(), out.data());
+        REQUIRE(out[36] == -36.0f);
+
+        delegate::BatchDelegate<float, float> from_function = static_cast<float (*)(float)>([](float value)
+        {
+            return value + 1.0f;
+        });
+        from_function.invoke_batch(in.data(), in.size(), out.data());
+        REQUIRE(out[36] == 37.0f);
+
+        scaled = from_delegate;
+        REQUIRE(scaled(1.0f) == -1.0f);
+        REQUIRE(scaled.get_delegate() == negate);
+    }
+
+    REQUIRE(!delegate::BatchDelegate<int, int>());
+}
+
+/** A CPU dispatch table at namespace scope, which selects during static initialization. */
+using UtKernel = delegate::CpuDispatch<int, int>;
+
+static UtKernel::Table ut_kernel({
+    {delegate::cpu_avx512f | delegate::cpu_avx512bw, [](int value){return value + 512;}},
+    {delegate::cpu_avx2 | delegate::cpu_fma, [](int value){return value + 2;}},
+    {0, [](int value){return value;}}});
+
+/** Test selecting kernel variants by CPU features. */
+TEST_CASE("CPU Dispatch", "[cpu_dispatch]")
+{
+    const uint32_t features = delegate::cpu_features();
+    const int expected = (features & delegate::cpu_avx512f) && (features & delegate::cpu_avx512bw) ? 512 :
+                         (features & delegate::cpu_avx2) && (features & delegate::cpu_fma) ? 2 : 0;
+    REQUIRE(ut_kernel(0) == expected);
+
+    UtKernel::Table table({
+        {delegate::cpu_avx512f | delegate::cpu_avx512bw, [](int value){return value + 512;}},
+        {delegate::cpu_avx2 | delegate::cpu_fma, [](int value){return value + 2;}},
+        {0, [](int value){return value;}}});
+
+    table.select(delegate::cpu_avx512f | delegate::cpu_avx512bw | delegate::cpu_avx2 | delegate::cpu_fma);
+    REQUIRE(table.index() == 0);
+    REQUIRE(table(1) == 513);
+
+    table.select(delegate::cpu_avx512f | delegate::cpu_avx2 | delegate::cpu_fma);
+    REQUIRE(table.index() == 1);
+    REQUIRE(table(1) == 3);
+
+    table.select(delegate::cpu_avx2);
+    REQUIRE(table.index() == 2);
+    REQUIRE(table(1) == 1);
+
+#ifndef WIN32
+    SECTION("Forced")
+    {
+        setenv("DELEGATE_CPU_FEATURES", "0x18", 1);
+        REQUIRE(delegate::detect_cpu_features() == (delegate::cpu_avx2 | delegate::cpu_fma));
+        table.select(delegate::detect_cpu_features());
+        REQUIRE(table(1) == 3);
+
+        setenv("DELEGATE_CPU_FEATURES", "0", 1);
+        REQUIRE(delegate::detect_cpu_features() == 0);
+
+        setenv("DELEGATE_CPU_FEATURES", "avx2", 1);
+        REQUIRE(delegate::detect_cpu_features() == features);
+
+        unsetenv("DELEGATE_CPU_FEATURES");
+        REQUIRE(delegate::detect_cpu_features() == features);
+    }
+#endif
+}
+
+/** A C API taking a callback and its context, which sums the callback's results. */
+static int c_sum(const int *values, int count, int (*callback)(void *context, int value), void *context)
+{
+    int sum = 0;
+    for (int index = 0; index < count; index++)
+    {
+        sum += callback(context, values[index]);
+    }
+
+    return sum;
+}
+
+/** Test delegates registered as C callbacks. */
+TEST_CASE("C Callback", "[c_callback]")
+{
+    const int values[] = {1, 2, 3};
+    int calls = 0;
+    delegate::Delegate<int, int> scaled = [&calls](int value)
+    {
+        calls++;
+        return value * 10;
+    };
+
+    const auto callback = delegate::c_callback(scaled);
+    REQUIRE(callback.context == &scaled);
+    REQUIRE(c_sum(values, 3, callback.function, callback.context) == 60);
+    REQUIRE(calls == 3);
+
+    // The trampoline is per signature, so a reassigned delegate is still called through it.
+    scaled = [](int value){return -value;};
+    REQUIRE(c_sum(values, 3, callback.function, callback.context) == -6);
+
+    auto owned = std::make_unique<int>(7);
+    const delegate::MoveDelegate<void, int &, const char *> move_only([owned = std::move(owned)](int &out, const char *)
+    {
+        out = *owned;
+    });
+    const auto last = delegate::c_callback_context_last(move_only);
+    int out = 0;
+    last.function(out, "ignored", last.context);
+    REQUIRE(out == 7);
+}
+
+#if defined(__linux__) && defined(__x86_64__)
+/** Test delegates called through plain function pointers. */
+TEST_CASE("Thunk Pool", "[thunk_pool]")
+{
+    delegate::ThunkPool pool;
+
+    int comparisons = 0;
+    const delegate::Delegate<int, const void *, const void *> descending = [&comparisons](const void *lhs,
+                                                                                           const void *rhs)
+    {
+        comparisons++;
+        return *static_cast<const int *>(rhs) - *static_cast<const int *>(lhs);
+    };
+    int values[] = {3, 1, 4, 1, 5, 9, 2, 6};
+    {
+        const auto thunk = pool.make_thunk(descending);
+        REQUIRE(thunk);
+        REQUIRE(pool.size() == 1);
+        qsort(values, std::size(values), sizeof(int), thunk.function());
+    }
+    REQUIRE(pool.size() == 0);
+    REQUIRE(comparisons > 0);
+    REQUIRE(std::is_sorted(std::begin(values), std::end(values), std::greater<int>()));
+
+    SECTION("Registers")
+    {
+        // Five integer arguments (the most), with floats between them, and a float result.
+        const double scale = 0.5;
+        const delegate::Delegate<double, int, double, const char *, long, float, int &, short> mixed =
+            [scale](int a, double b, const char *c, long d, float e, int &f, short g)
+        {
+            f = a + int(d) + g;
+            return (b + e) * scale + double(c[0]);
+        };
+        const auto thunk = pool.make_thunk(mixed);
+        int sum = 0;
+        REQUIRE(thunk.function()(1, 2.0, "A", 10L, 4.0f, sum, short(100)) == 3.0 + 'A');
+        REQUIRE(sum == 111);
+
+        const delegate::MoveDelegate<void> none([owned = std::make_unique<int>(5), &sum]()
+        {
+            sum = *owned;
+        });
+        const auto no_arguments = pool.make_thunk(none);
+        no_arguments.function()();
+        REQUIRE(sum == 5);
+    }
+
+    SECTION("Slabs")
+    {
+        const delegate::Delegate<size_t, size_t> identity = [](size_t value){return value;};
+        std::vector<delegate::Delegate<size_t, size_t>> offsets;
+        for (size_t offset = 0; offset < 3 * delegate::ThunkPool::slab_size / delegate::ThunkPool::slot_size;
+             offset++)
+        {
+            offsets.emplace_back([offset](size_t value){return value + offset;});
+        }
+
+        std::vector<delegate::Thunk<size_t, size_t>> thunks;
+        std::unordered_set<size_t (*)(size_t)> functions;
+        for (const auto &offset : offsets)
+        {
+            thunks.push_back(pool.make_thunk(offset));
+            functions.insert(thunks.back().function());
+        }
+        REQUIRE(functions.size() == offsets.size());
+
+        bool all_called = true;
+        for (size_t index = 0; index < thunks.size(); index++)
+        {
+            all_called = all_called && thunks[index].function()(1) == index + 1;
+        }
+        REQUIRE(all_called);
+
+        // Released memory is reused.
+        const auto released = thunks[7].function();
+        thunks[7].release();
+        REQUIRE(!thunks[7]);
+        REQUIRE(thunks[7].function() == nullptr);
+        delegate::Thunk<size_t, size_t> reused = pool.make_thunk(identity);
+        REQUIRE(reused.function() == released);
+        REQUIRE(reused.function()(42) == 42);
+
+        delegate::Thunk<size_t, size_t> moved = std::move(reused);
+        REQUIRE(!reused);
+        REQUIRE(moved.function()(43) == 43);
+        thunks.clear();
+        REQUIRE(pool.size() == 1);
+    }
+}
+#endif
+
+#ifdef __linux__
+/** Test delegates bound to shared library symbols on first call. */
+TEST_CASE("Lazy Delegate", "[lazy_delegate]")
+{
+    delegate::LazyDelegate<size_t, const char *> length(RTLD_DEFAULT, "strlen");
+    REQUIRE(!length.resolved());
+    REQUIRE(length("plugin") == 6);
+    REQUIRE(length.resolved());
+    REQUIRE(length("") == 0);
+
+    const delegate::Delegate<size_t, const char *> bound = length.get_delegate();
+    REQUIRE(bound("host") == 4);
+    REQUIRE(bound == length.get_delegate());
+
+    delegate::LazyDelegate<size_t, const char *> unresolved(RTLD_DEFAULT, "strlen");
+    const delegate::Delegate<size_t, const char *> nested = unresolved.get_delegate();
+    REQUIRE(!unresolved.resolved());
+    REQUIRE(nested("nested") == 6);
+    REQUIRE(unresolved.resolved());
+    REQUIRE(nested != unresolved.get_delegate());
+    REQUIRE(unresolved.get_delegate() == bound);
+
+    delegate::LazyDelegate<int, int> missing(RTLD_DEFAULT, "delegate_no_such_symbol");
+    REQUIRE(!missing.resolve());
+    REQUIRE(!missing.resolved());
+    REQUIRE(strcmp(missing.get_name(), "delegate_no_such_symbol") == 0);
+
+    SECTION("Concurrent First Calls")
+    {
+        delegate::LazyDelegate<int, int> absolute(RTLD_DEFAULT, "abs");
+        std::atomic<bool> start(false);
+        std::atomic<int> correct(0);
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 8; thread++)
+        {
+            threads.emplace_back([&, thread]()
+            {
+                while (!start.load())
+                {
+                }
+                for (int call = 0; call < 1000; call++)
+                {
+                    correct += absolute(-thread - call) == thread + call;
+                }
+            });
+        }
+        start = true;
+        for (std::thread &thread : threads)
+        {
+            thread.join();
+        }
+
+        REQUIRE(correct == 8000);
+        REQUIRE(absolute.resolved());
+    }
+}
+#endif
+
 /** Test trivial functions (no captures). */
 TEST_CASE("Trivial Function", "[trivial_function]")
 {
@@ -0,0 +1,27 @@
+#define DELEGATE_ARGS_SIZE 24
+#define DELEGATE_ARGS_ALIGN 8
+#include "delegate_ut_tu.h"
+
+namespace OtherUnit
+{
+    int negate(int value)
+    {
+        return -value;
+    }
+
+    delegate::Delegate<int, int> make_negate()
+    {
+        return delegate::Delegate<int, int>(&negate);
+    }
+
+    bool default_is_callable()
+    {
+        delegate::Delegate<int, int> f;
+        return !!f;
+    }
+
+    delegate::Delegate<int, int> make_add(int amount)
+    {
+        return delegate::Delegate<int, int>(Add{amount});
+    }
+}
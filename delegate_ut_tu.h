@@ -0,0 +1,53 @@
+#pragma once
+/**
+ * Delegates made in a second translation unit (delegate_ut_tu.cpp), for checking that delegates behave the same
+ * whichever translation unit made them.  Both units must be compiled with the same DELEGATE_ARGS_SIZE and
+ * DELEGATE_ARGS_ALIGN.
+ */
+#include "delegate/delegate.h"
+
+namespace OtherUnit
+{
+    /** A named functor, which is the same type in both translation units. */
+    struct Add
+    {
+        int amount;
+
+        int operator()(int value) const
+        {
+            return value + amount;
+        }
+    };
+
+    /**
+     * A function defined in the other unit.
+     *
+     * @param value The value to negate.
+     *
+     * @return The negated value.
+     */
+    int negate(int value);
+
+    /**
+     * Make a delegate holding a pointer to negate() in the other unit.
+     *
+     * @return The delegate.
+     */
+    delegate::Delegate<int, int> make_negate();
+
+    /**
+     * Whether a delegate default constructed in the other unit reports being callable.
+     *
+     * @return Returns true if callable (which would be a bug), else false.
+     */
+    bool default_is_callable();
+
+    /**
+     * Make a delegate holding an Add in the other unit.
+     *
+     * @param amount The amount to add.
+     *
+     * @return The delegate.
+     */
+    delegate::Delegate<int, int> make_add(int amount);
+}
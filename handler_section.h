@@ -0,0 +1,218 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <exception>
+#include <mutex>
+#include <string_view>
+#include <vector>
+#include "delegate.h"
+
+#ifndef __ELF__
+ #error "Handler sections need an ELF target."
+#endif
+
+namespace delegate
+{
+    /**
+     * A handler registered in a handler section: its key and function.  Records are constant-initialized and
+     * trivially destructible, so registering one runs no code at startup (or exit).  They hold the function rather
+     * than a delegate because a delegate's destructor would register an exit handler per record.
+     *
+     * @tparam Result The handler return type.
+     * @tparam Arguments The handler function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    struct HandlerRecord
+    {
+        /** The key the handler is found by. */
+        const char *key;
+
+        /** The handler. */
+        Result (*function)(Arguments...);
+    };
+
+    /**
+     * Handlers registered at link time.  Each registration puts a pointer to its record in a dedicated linker
+     * section, and the linker gathers them all between the section's __start_ and __stop_ symbols, so there's no
+     * static initializer per handler (or a global map to push into).  Lookups use an index sorted by key, built on
+     * first use.
+     *
+     * Declare a section with DELEGATE_HANDLER_SECTION (e.g. in a header), register handlers with
+     * DELEGATE_REGISTER_HANDLER in any translation unit, then look them up through the declared type.  Handlers are
+     * functions or capture-less lambdas.  Registering two handlers with the same key terminates on the first lookup.
+     *
+     * Registrations in a static library are only linked if something else pulls in their object file, as with any
+     * static registration.
+     *
+     * Example:
+     *      DELEGATE_HANDLER_SECTION(commands, void, Session &);
+     *      DELEGATE_REGISTER_HANDLER(commands, "quit", [](Session &session){session.close();});
+     *      ...
+     *      if (const auto *handler = commands::find(name)) (*handler)(session);
+     *
+     * @tparam Section The type declared by DELEGATE_HANDLER_SECTION.
+     * @tparam Result The handler return type.
+     * @tparam Arguments The handler function arguments.
+     */
+    template<typename Section, typename Result, typename... Arguments>
+    class HandlerSection
+    {
+    public:
+        /** A registered handler. */
+        using Record = HandlerRecord<Result, Arguments...>;
+
+        /** The delegate type handlers are found as. */
+        using DelegateType = Delegate<Result, Arguments...>;
+
+        /**
+         * Returns the number of registered handlers.
+         *
+         * @return The number of handlers.
+         */
+        static size_t size()
+        {
+            return size_t(Section::end() - Section::begin());
+        }
+
+        /**
+         * Visit every registered handler, in link order.  Doesn't build the index.
+         *
+         * @tparam Visitor The visitor type.
+         * @param visitor Called with each record.
+         */
+        template<typename Visitor>
+        static void for_each(Visitor &&visitor)
+        {
+            for (const Record *const *record = Section::begin(); record != Section::end(); record++)
+            {
+                visitor(**record);
+            }
+        }
+
+        /**
+         * Find a handler by key.
+         *
+         * @param key The key.
+         *
+         * @return Returns the handler, or nullptr if no handler has the key.
+         */
+        static const DelegateType *find(std::string_view key)
+        {
+            const std::vector<Entry> &entries = index();
+            const auto found = std::lower_bound(entries.begin(), entries.end(), key, [](const Entry &entry,
+                                                                                     std::string_view key)
+            {
+                return entry.key < key;
+            });
+
+            return found != entries.end() && found->key == key ? &found->delegate : nullptr;
+        }
+
+    private:
+        /** An index entry. */
+        struct Entry
+        {
+            std::string_view key;
+            DelegateType delegate;
+        };
+
+        /**
+         * Returns the index of the handlers, sorted by key, building it on first use.
+         *
+         * @return The index.
+         */
+        static const std::vector<Entry> &index()
+        {
+            static std::vector<Entry> entries;
+            static std::once_flag built;
+
+            std::call_once(built, []()
+            {
+                entries.reserve(size());
+                for_each([](const Record &record)
+                {
+                    entries.push_back(Entry{record.key, DelegateType(record.function)});
+                });
+
+                std::sort(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs)
+                {
+                    return lhs.key < rhs.key;
+                });
+                if (std::adjacent_find(entries.begin(), entries.end(), [](const Entry &lhs, const Entry &rhs)
+                {
+                    return lhs.key == rhs.key;
+                }) != entries.end())
+                {
+                    std::terminate();
+                }
+            });
+
+            return entries;
+        }
+    };
+}
+
+/**
+ * Declare a handler section: a type of the given name with HandlerSection's static functions.  The section symbols
+ * are weak, so a section with no handlers is empty rather than a link error.
+ *
+ * @param name The section name, an identifier.
+ * @param ... The handler return type, then argument types.
+ */
+#define DELEGATE_HANDLER_SECTION(name, ...) \
+    extern "C" __attribute__((weak)) const ::delegate::HandlerRecord<__VA_ARGS__> *const __start_delegate_##name[]; \
+    extern "C" __attribute__((weak)) const ::delegate::HandlerRecord<__VA_ARGS__> *const __stop_delegate_##name[]; \
+    struct name : ::delegate::HandlerSection<name, __VA_ARGS__> \
+    { \
+        static const Record *const *begin() \
+        { \
+            return __start_delegate_##name; \
+        } \
+        static const Record *const *end() \
+        { \
+            return __stop_delegate_##name; \
+        } \
+    }
+
+/**
+ * Register a handler in a section declared with DELEGATE_HANDLER_SECTION.  Use at namespace scope.
+ *
+ * @param name The section name.
+ * @param key The key, a string literal (or other string with static storage).
+ * @param function The handler, a function or capture-less lambda.
+ */
+#define DELEGATE_REGISTER_HANDLER(name, key, function) \
+    DELEGATE_REGISTER_HANDLER_AT(name, key, function, __COUNTER__)
+
+#define DELEGATE_REGISTER_HANDLER_AT(name, key, function, counter) \
+    DELEGATE_REGISTER_HANDLER_RECORD(name, key, function, DELEGATE_HANDLER_CONCAT(delegate_handler_, counter), \
+                                     DELEGATE_HANDLER_CONCAT(delegate_handler_pointer_, counter))
+
+#define DELEGATE_REGISTER_HANDLER_RECORD(name, key, function, record, pointer) \
+    static constexpr name::Record record{key, function}; \
+    __attribute__((used, section("delegate_" #name), aligned(sizeof(void *)))) \
+    static const name::Record *const pointer = &record
+
+#define DELEGATE_HANDLER_CONCAT(prefix, counter) DELEGATE_HANDLER_CONCAT_EXPANDED(prefix, counter)
+#define DELEGATE_HANDLER_CONCAT_EXPANDED(prefix, counter) prefix##counter
@@ -0,0 +1,466 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include "delegate.h"
+
+namespace delegate
+{
+    /** Allow the number of stable ids (per delegate signature) to be specified as a compile-time constant. */
+    #ifndef DELEGATE_MAX_STABLE_IDS
+     #define DELEGATE_MAX_STABLE_IDS 256
+     #define DELEGATE_MAX_STABLE_IDS_UNDEF
+    #endif
+
+    /** A functor type's id, the same in every process running the same binary. */
+    using StableId = uint32_t;
+
+    /**
+     * Registry of functor types with stable ids, for passing delegates between processes.  Call and vtable pointers
+     * differ between processes (ASLR), so a delegate is sent as its functor type's stable id and capture bytes, and
+     * rebuilt from the id on the other side.
+     *
+     * Only functor types with trivially copyable captures can be registered, and the captures must also mean the same
+     * thing in every process (i.e. no pointers into process memory).  Ids are chosen by the caller (e.g. from an
+     * enum), and every process must register the same types with the same ids, e.g. at startup.
+     *
+     * Example:
+     *      auto on_order = [](const int quantity){...};
+     *      using Registry = delegate::TypeRegistry<void, int>;
+     *      Registry::register_type<decltype(on_order)>(1);
+     *
+     * @tparam Result The delegate return type.
+     * @tparam Arguments The delegate function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    class TypeRegistry
+    {
+    public:
+        /** The delegate type of the registered functors. */
+        using DelegateType = Delegate<Result, Arguments...>;
+
+        /** The number of stable ids, i.e. ids range over [0, max_ids). */
+        static constexpr StableId max_ids = DELEGATE_MAX_STABLE_IDS;
+
+        /** How a registered functor type is saved to and restored from bytes. */
+        struct Record
+        {
+            /** The functor type's stable id. */
+            StableId id;
+
+            /** The functor type's identity in this process. */
+            typename DelegateType::TypeId type;
+
+            /** Copy the capture bytes of a delegate holding this functor type. */
+            void (& save)(const DelegateType &delegate, FunctorArgs &bytes);
+
+            /** Rebuild a delegate holding this functor type from capture bytes. */
+            void (& restore)(const FunctorArgs &bytes, DelegateType &delegate);
+        };
+
+        /**
+         * Register a functor type with a stable id.  Registering the same type and id again is harmless; reusing an
+         * id for another type, or an id out of range, terminates.
+         *
+         * @tparam T The functor type.
+         * @param id The stable id.
+         *
+         * @return Returns true, so registration can initialize a static.
+         */
+        template<typename T>
+        static bool register_type(StableId id)
+        {
+            static_assert(std::is_trivially_copyable_v<T>, "Only trivially copyable captures can be sent.");
+            static_assert(can_emplace<T>(), "Delegate doesn't fit.");
+
+            static const Record record = {id, DelegateType::template type_id<T>(), typed_save<T>, typed_restore<T>};
+            Table &table = get_table();
+            if (id >= max_ids || record.id != id || (table.by_id[id] != nullptr && table.by_id[id] != &record))
+            {
+                std::terminate();
+            }
+
+            if (table.by_id[id] == nullptr)
+            {
+                // Keep the records sorted by type, for finding by type with a binary search.
+                table.by_id[id] = &record;
+                const Record **end = table.by_type.data() + table.count++;
+                const Record **position = std::upper_bound(table.by_type.data(), end, &record, compare_type);
+                std::move_backward(position, end, end + 1);
+                *position = &record;
+            }
+
+            return true;
+        }
+
+        /**
+         * Find the record of a stable id.
+         *
+         * @param id The stable id.
+         *
+         * @return Returns the record, or nullptr if the id isn't registered.
+         */
+        static const Record *find(StableId id)
+        {
+            return id < max_ids ? get_table().by_id[id] : nullptr;
+        }
+
+        /**
+         * Find the record of the functor type held by a delegate.
+         *
+         * @param delegate The delegate.
+         *
+         * @return Returns the record, or nullptr if the functor type isn't registered.
+         */
+        static const Record *find(const DelegateType &delegate)
+        {
+            const Table &table = get_table();
+            const typename DelegateType::TypeId type = delegate.target_type();
+            const Record *const *end = table.by_type.data() + table.count;
+            const Record *const *found = std::lower_bound(table.by_type.data(), end, type,
+                [](const Record *record, typename DelegateType::TypeId type)
+                {
+                    return std::less<typename DelegateType::TypeId>()(record->type, type);
+                });
+
+            return found != end && (*found)->type == type ? *found : nullptr;
+        }
+
+    private:
+        /** The registered records. */
+        struct Table
+        {
+            /** Records indexed by stable id. */
+            std::array<const Record *, max_ids> by_id;
+
+            /** Records sorted by type, for finding by type without visiting every id. */
+            std::array<const Record *, max_ids> by_type;
+
+            /** The number of registered records. */
+            size_t count;
+        };
+
+        /**
+         * Orders records by type, for the by type table.
+         *
+         * @param lhs The first record.
+         * @param rhs The second record.
+         *
+         * @return Returns true if the first record's type orders before the second's, else false.
+         */
+        static bool compare_type(const Record *lhs, const Record *rhs)
+        {
+            return std::less<typename DelegateType::TypeId>()(lhs->type, rhs->type);
+        }
+
+        /**
+         * Returns the registered records.
+         *
+         * @return The records.
+         */
+        static Table &get_table()
+        {
+            static Table table = {};
+
+            return table;
+        }
+
+        /**
+         * Actual code to copy a delegate's capture bytes.
+         *
+         * @tparam T The functor type.
+         * @param delegate The delegate holding a T.
+         * @param bytes The memory to copy to.
+         */
+        template<typename T>
+        static void typed_save(const DelegateType &delegate, FunctorArgs &bytes)
+        {
+            store_functor<T>(bytes, *delegate.template target<T>());
+        }
+
+        /**
+         * Actual code to rebuild a delegate from capture bytes.
+         *
+         * @tparam T The functor type.
+         * @param bytes The capture bytes of a T.
+         * @param delegate The delegate to assign to.
+         */
+        template<typename T>
+        static void typed_restore(const FunctorArgs &bytes, DelegateType &delegate)
+        {
+            delegate = get_typed_functor<T>(bytes);
+        }
+    };
+
+    #ifdef DELEGATE_MAX_STABLE_IDS_UNDEF
+     #undef DELEGATE_MAX_STABLE_IDS
+     #undef DELEGATE_MAX_STABLE_IDS_UNDEF
+    #endif
+
+    /**
+     * Bounded multi-producer queue of delegates in shared memory, for passing delegates between processes of the same
+     * binary.  Each entry is a registered functor type's stable id plus its capture bytes (see TypeRegistry), and
+     * the consumer rebuilds an invokable delegate from them.
+     *
+     * The queue keeps all of its state in the memory it's given, and addresses nothing by pointer, so processes may
+     * map the memory at different addresses.  Slots carry sequence numbers (a Vyukov bounded queue), so any number
+     * of producers may push at once; popping from several consumers at once is also safe.
+     *
+     * Example (both processes):
+     *      int fd = shm_open("/orders", O_CREAT | O_RDWR, 0600);
+     *      ftruncate(fd, Queue::required_size(1024));
+     *      void *memory = mmap(nullptr, Queue::required_size(1024), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+     *      Queue queue = creator ? Queue::create(memory, 1024) : Queue::attach(memory);
+     *
+     * @tparam Result The delegate return type.
+     * @tparam Arguments The delegate function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    class IpcQueue
+    {
+    public:
+        /** The functor type registry used by the queue. */
+        using Registry = TypeRegistry<Result, Arguments...>;
+
+        /** The delegate type sent through the queue. */
+        using DelegateType = typename Registry::DelegateType;
+
+        static_assert(std::atomic<uint64_t>::is_always_lock_free, "Shared memory needs address-free atomics.");
+
+        /**
+         * Returns the number of bytes of shared memory a queue needs.
+         *
+         * @param capacity The number of entries, a power of two.
+         *
+         * @return The number of bytes.
+         */
+        static constexpr size_t required_size(size_t capacity)
+        {
+            return sizeof(Header) + capacity * sizeof(Slot);
+        }
+
+        /**
+         * Initialize a queue in (zeroed or otherwise unused) shared memory.
+         *
+         * @param memory The shared memory, at least required_size(capacity) bytes, aligned to a cache line.
+         * @param capacity The number of entries, a power of two.
+         *
+         * @return Returns the queue.
+         */
+        static IpcQueue create(void *memory, size_t capacity)
+        {
+            if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+            {
+                std::terminate();
+            }
+
+            Header *header = ::new (memory) Header();
+            header->capacity = capacity;
+
+            Slot *slots = reinterpret_cast<Slot *>(header + 1);
+            for (size_t index = 0; index < capacity; index++)
+            {
+                ::new (&slots[index]) Slot();
+                slots[index].sequence.store(index, std::memory_order_relaxed);
+            }
+
+            header->magic.store(magic, std::memory_order_release);
+
+            return IpcQueue(header);
+        }
+
+        /**
+         * Use a queue another process initialized with create().  The queue must have been created by the same
+         * binary.
+         *
+         * @param memory The shared memory.
+         *
+         * @return Returns the queue.
+         */
+        static IpcQueue attach(void *memory)
+        {
+            Header *header = static_cast<Header *>(memory);
+            if (header->magic.load(std::memory_order_acquire) != magic)
+            {
+                std::terminate();
+            }
+
+            return IpcQueue(header);
+        }
+
+        /**
+         * Push a functor of a registered type.
+         *
+         * @tparam T The functor type.
+         * @param functor The functor to push.
+         *
+         * @return Returns true if pushed, false if the queue is full.
+         */
+        template<typename T>
+        bool push(const T &functor)
+        {
+            return push(DelegateType(functor));
+        }
+
+        /**
+         * Push a delegate holding a functor of a registered type.  Pushing any other delegate terminates.
+         *
+         * @param delegate The delegate to push.
+         *
+         * @return Returns true if pushed, false if the queue is full.
+         */
+        bool push(const DelegateType &delegate)
+        {
+            const typename Registry::Record *record = Registry::find(delegate);
+            if (record == nullptr)
+            {
+                std::terminate();
+            }
+
+            uint64_t position = header->enqueue_position.load(std::memory_order_relaxed);
+            Slot *slot;
+            while (true)
+            {
+                slot = &slots()[position & (header->capacity - 1)];
+                const int64_t difference = int64_t(slot->sequence.load(std::memory_order_acquire) - position);
+                if (difference == 0)
+                {
+                    if (header->enqueue_position.compare_exchange_weak(position, position + 1,
+                                                                       std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = header->enqueue_position.load(std::memory_order_relaxed);
+                }
+            }
+
+            slot->id = record->id;
+            record->save(delegate, slot->bytes);
+            slot->sequence.store(position + 1, std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * Pop the oldest entry, rebuilt as a delegate.
+         *
+         * @param delegate The delegate to assign the entry to.
+         *
+         * @return Returns true if popped, false if the queue is empty.
+         */
+        bool pop(DelegateType &delegate)
+        {
+            uint64_t position = header->dequeue_position.load(std::memory_order_relaxed);
+            Slot *slot;
+            while (true)
+            {
+                slot = &slots()[position & (header->capacity - 1)];
+                const int64_t difference = int64_t(slot->sequence.load(std::memory_order_acquire) - (position + 1));
+                if (difference == 0)
+                {
+                    if (header->dequeue_position.compare_exchange_weak(position, position + 1,
+                                                                       std::memory_order_relaxed))
+                    {
+                        break;
+                    }
+                }
+                else if (difference < 0)
+                {
+                    return false;
+                }
+                else
+                {
+                    position = header->dequeue_position.load(std::memory_order_relaxed);
+                }
+            }
+
+            const typename Registry::Record *record = Registry::find(slot->id);
+            if (record == nullptr)
+            {
+                std::terminate();
+            }
+
+            record->restore(slot->bytes, delegate);
+            slot->sequence.store(position + header->capacity, std::memory_order_release);
+
+            return true;
+        }
+
+    private:
+        /** Identifies initialized queue memory. */
+        static constexpr uint64_t magic = 0x44656c6567617465ull ^ sizeof(FunctorArgs);
+
+        /** Queue state at the start of the shared memory.  Producer and consumer positions get their own lines. */
+        struct Header
+        {
+            alignas(64) std::atomic<uint64_t> magic{0};
+            uint64_t capacity = 0;
+            alignas(64) std::atomic<uint64_t> enqueue_position{0};
+            alignas(64) std::atomic<uint64_t> dequeue_position{0};
+        };
+
+        /** An entry, after the header.  The sequence number tells producers and consumers whose turn it is. */
+        struct alignas(64) Slot
+        {
+            std::atomic<uint64_t> sequence{0};
+            StableId id = 0;
+            FunctorArgs bytes;
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param header The queue state in shared memory.
+         */
+        explicit IpcQueue(Header *header) : header(header)
+        {
+        }
+
+        /**
+         * Returns the slots.
+         *
+         * @return The slots.
+         */
+        Slot *slots() const
+        {
+            return reinterpret_cast<Slot *>(header + 1);
+        }
+
+        /** The queue state in shared memory. */
+        Header *header;
+    };
+}
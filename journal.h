@@ -0,0 +1,533 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "ipc_queue.h"
+
+namespace delegate
+{
+    /** Allow the size of the block a thread claims in a journal to be specified as a compile-time constant. */
+    #ifndef DELEGATE_JOURNAL_BLOCK_SIZE
+     #define DELEGATE_JOURNAL_BLOCK_SIZE 65536
+     #define DELEGATE_JOURNAL_BLOCK_SIZE_UNDEF
+    #endif
+
+    /**
+     * Append-only journal of delegate invocations in a memory-mapped file, for replaying recorded work later (e.g.
+     * the tasks posted to an executor before an incident).  Each record is a registered functor type's stable id and
+     * capture bytes (see TypeRegistry), the call's arguments, and a timestamp.
+     *
+     * Recording is lock-free: each thread claims a block of the file with one atomic add, then appends to it with
+     * plain stores, so there's no contention between threads.  A record is only visible once complete, and the
+     * records survive the process crashing, since they're written straight into the file's pages.  When the file is
+     * full, records are dropped and counted.
+     *
+     * A thread keeps one block per signature, so a thread alternating between two journals of the same signature
+     * claims a new block on every switch.
+     *
+     * Example:
+     *      using Journal = delegate::Journal<void, int>;
+     *      Journal::Registry::register_type<Task>(1);
+     *      Journal journal("tasks.journal", 64 * 1024 * 1024);
+     *      journal.record(task, 42);
+     *      ...
+     *      Journal::Replayer("tasks.journal").replay();
+     *
+     * @tparam Result The delegate return type.
+     * @tparam Arguments The delegate function arguments - trivially copyable, and not mutable references.
+     */
+    template<typename Result, typename... Arguments>
+    class Journal
+    {
+    public:
+        /** The functor type registry used by the journal. */
+        using Registry = TypeRegistry<Result, Arguments...>;
+
+        /** The delegate type recorded by the journal. */
+        using DelegateType = typename Registry::DelegateType;
+
+        static_assert((std::is_trivially_copyable_v<std::decay_t<Arguments>> && ...),
+                      "Only trivially copyable arguments can be recorded.");
+        static_assert(((!std::is_lvalue_reference_v<Arguments> || std::is_const_v<std::remove_reference_t<Arguments>>)
+                      && ...), "Mutable reference arguments can't be replayed.");
+
+        /** The size of the block a thread claims. */
+        static constexpr size_t block_size = DELEGATE_JOURNAL_BLOCK_SIZE;
+
+        /**
+         * Constructor.  Creates (or truncates) the file, sized to hold capacity bytes of records.
+         *
+         * @param path The file path.
+         * @param capacity The capacity in bytes, rounded up to whole blocks.
+         */
+        Journal(const char *path, size_t capacity) : generation(next_generation())
+        {
+            const size_t blocks = (capacity + block_size - 1) / block_size;
+            size = sizeof(Header) + blocks * block_size;
+
+            fd = ::open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+            if (fd < 0 || ::ftruncate(fd, off_t(size)) != 0)
+            {
+                return;
+            }
+
+            // Fault the pages in now, rather than on the recording path.
+            #ifdef MAP_POPULATE
+            const int populate = MAP_POPULATE;
+            #else
+            const int populate = 0;
+            #endif
+            void *memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | populate, fd, 0);
+            if (memory == MAP_FAILED)
+            {
+                return;
+            }
+
+            header = ::new (memory) Header();
+            header->magic = magic;
+            header->record_size = record_size;
+            header->block_size = block_size;
+            header->block_count = blocks;
+        }
+
+        Journal(const Journal &other) = delete;
+        Journal &operator=(const Journal &other) = delete;
+
+        /**
+         * Destructor.  The records stay in the file.  No thread may be recording.
+         */
+        ~Journal()
+        {
+            if (header != nullptr)
+            {
+                ::munmap(header, size);
+            }
+            if (fd >= 0)
+            {
+                ::close(fd);
+            }
+        }
+
+        /**
+         * Determine whether the journal file was created and mapped.
+         *
+         * @return Returns true if the file was created and mapped, else false.
+         */
+        explicit operator bool() const
+        {
+            return header != nullptr;
+        }
+
+        /**
+         * Record an invocation of a delegate holding a functor of a registered type.  Recording any other delegate
+         * terminates.
+         *
+         * @param delegate The delegate.
+         * @param arguments The call's arguments.
+         *
+         * @return Returns true if recorded, false if the journal is full (or failed to open).
+         */
+        bool record(const DelegateType &delegate, Arguments... arguments)
+        {
+            const typename Registry::Record *type = Registry::find(delegate);
+            if (type == nullptr)
+            {
+                std::terminate();
+            }
+
+            Cursor &cursor = get_cursor();
+            if ((cursor.generation != generation || cursor.next == cursor.end) && !claim_block(cursor))
+            {
+                dropped_records.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+
+            char *bytes = cursor.next;
+            cursor.next += record_size;
+
+            Entry *entry = ::new (bytes) Entry;
+            entry->timestamp = uint64_t(std::chrono::steady_clock::now().time_since_epoch().count());
+            entry->id = type->id;
+            type->save(delegate, entry->bytes);
+            [[maybe_unused]] size_t index = 0;
+            (::memcpy(bytes + layout[index++], &arguments, sizeof(std::decay_t<Arguments>)), ...);
+            entry->size.store(uint32_t(record_size), std::memory_order_release);
+
+            return true;
+        }
+
+        /**
+         * Returns the number of records dropped because the journal was full.
+         *
+         * @return The number of records.
+         */
+        uint64_t dropped() const
+        {
+            return dropped_records.load(std::memory_order_relaxed);
+        }
+
+    private:
+        /** The file header, followed by the blocks. */
+        struct alignas(64) Header
+        {
+            uint64_t magic = 0;
+            uint64_t record_size = 0;
+            uint64_t block_size = 0;
+            uint64_t block_count = 0;
+            std::atomic<uint64_t> blocks_used{0};
+        };
+
+        /** The start of a record, followed by the arguments.  Size is stored last, and is zero until complete. */
+        struct Entry
+        {
+            uint64_t timestamp;
+            std::atomic<uint32_t> size;
+            StableId id;
+            FunctorArgs bytes;
+        };
+
+        /** A thread's position in its claimed block. */
+        struct Cursor
+        {
+            uint64_t generation;
+            char *next;
+            char *end;
+        };
+
+        /**
+         * Returns the offsets of the arguments in a record, followed by the record size.
+         *
+         * @return The offsets.
+         */
+        static constexpr std::array<size_t, sizeof...(Arguments) + 1> get_layout()
+        {
+            constexpr size_t sizes[] = {sizeof(std::decay_t<Arguments>)..., 0};
+            constexpr size_t alignments[] = {alignof(std::decay_t<Arguments>)..., alignof(Entry)};
+
+            std::array<size_t, sizeof...(Arguments) + 1> offsets = {};
+            size_t offset = sizeof(Entry);
+            for (size_t index = 0; index <= sizeof...(Arguments); index++)
+            {
+                offset = (offset + alignments[index] - 1) / alignments[index] * alignments[index];
+                offsets[index] = offset;
+                offset += sizes[index];
+            }
+
+            return offsets;
+        }
+
+        /** The offsets of the arguments in a record, followed by the record size. */
+        static constexpr std::array<size_t, sizeof...(Arguments) + 1> layout = get_layout();
+
+        /** The size of a record. */
+        static constexpr size_t record_size = layout[sizeof...(Arguments)];
+
+        static_assert(record_size <= block_size, "A record doesn't fit in a block.");
+
+        /**
+         * Returns the magic number identifying a journal file of this signature.  The sizes and alignments of the
+         * arguments tell apart most signatures with the same record size.
+         *
+         * @return The magic number.
+         */
+        static constexpr uint64_t get_magic()
+        {
+            constexpr size_t shapes[] = {sizeof(std::decay_t<Arguments>)..., alignof(std::decay_t<Arguments>)..., 0};
+
+            uint64_t magic = 0x4a6f75726e616cull ^ sizeof(FunctorArgs);
+            for (const size_t shape : shapes)
+            {
+                magic = (magic ^ shape) * 0x100000001b3ull;
+            }
+
+            return magic;
+        }
+
+        /** Identifies a journal file of this signature. */
+        static constexpr uint64_t magic = get_magic();
+
+        /**
+         * Copy a recorded argument out of the file.
+         *
+         * @tparam T The argument type.
+         * @param bytes The argument's bytes.
+         *
+         * @return The argument.
+         */
+        template<typename T>
+        static T load(const char *bytes)
+        {
+            union Storage
+            {
+                Storage() {}
+                char empty;
+                T value;
+            } storage;
+            ::memcpy(&storage.value, bytes, sizeof(T));
+
+            return storage.value;
+        }
+
+        /**
+         * Claim a new block for this thread.
+         *
+         * @param cursor The thread's cursor.
+         *
+         * @return Returns true if claimed, false if the journal is full.
+         */
+        bool claim_block(Cursor &cursor)
+        {
+            if (header == nullptr)
+            {
+                return false;
+            }
+
+            // Once full, every record would claim again, so check with a load rather than writing the shared line.
+            if (header->blocks_used.load(std::memory_order_relaxed) >= header->block_count)
+            {
+                cursor.generation = 0;
+                return false;
+            }
+
+            const uint64_t block = header->blocks_used.fetch_add(1, std::memory_order_relaxed);
+            if (block >= header->block_count)
+            {
+                cursor.generation = 0;
+                return false;
+            }
+
+            char *start = reinterpret_cast<char *>(header + 1) + block * block_size;
+            cursor.generation = generation;
+            cursor.next = start;
+            cursor.end = start + block_size / record_size * record_size;
+
+            return true;
+        }
+
+        /**
+         * Returns this thread's cursor.
+         *
+         * @return The cursor.
+         */
+        static Cursor &get_cursor()
+        {
+            thread_local Cursor cursor = {};
+
+            return cursor;
+        }
+
+        /**
+         * Returns a new journal generation, so a thread can't mistake its cursor for one into another journal.
+         *
+         * @return The generation.
+         */
+        static uint64_t next_generation()
+        {
+            static std::atomic<uint64_t> generation{0};
+
+            return generation.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+
+        /** Identifies this journal to threads' cursors. */
+        const uint64_t generation;
+
+        /** The file. */
+        int fd = -1;
+
+        /** The mapped size of the file. */
+        size_t size = 0;
+
+        /** The mapped file header, or nullptr if the file failed to open. */
+        Header *header = nullptr;
+
+        /** The number of records dropped because the journal was full. */
+        std::atomic<uint64_t> dropped_records{0};
+
+    public:
+        /**
+         * Replays a journal file: rebuilds each recorded delegate and invokes it with the recorded arguments, in
+         * timestamp order.  Records from one thread keep their order.  The registry must hold the same types and
+         * ids as the recording process.
+         */
+        class Replayer
+        {
+        public:
+            /**
+             * Constructor.  Maps the file and orders its records.
+             *
+             * @param path The file path.
+             */
+            explicit Replayer(const char *path)
+            {
+                const int fd = ::open(path, O_RDONLY);
+                if (fd < 0)
+                {
+                    return;
+                }
+
+                struct stat status;
+                if (::fstat(fd, &status) == 0 && size_t(status.st_size) >= sizeof(Header))
+                {
+                    void *memory = ::mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                    if (memory != MAP_FAILED)
+                    {
+                        base = static_cast<const char *>(memory);
+                        mapped_size = size_t(status.st_size);
+                    }
+                }
+                ::close(fd);
+
+                const Header *header = reinterpret_cast<const Header *>(base);
+                if (base == nullptr || header->magic != magic || header->record_size != record_size ||
+                    header->block_size != block_size ||
+                    sizeof(Header) + header->block_count * block_size > mapped_size)
+                {
+                    return;
+                }
+
+                const uint64_t blocks = std::min<uint64_t>(header->blocks_used.load(std::memory_order_relaxed),
+                                                           header->block_count);
+                for (uint64_t block = 0; block < blocks; block++)
+                {
+                    const char *start = base + sizeof(Header) + block * block_size;
+                    for (const char *bytes = start; bytes + record_size <= start + block_size; bytes += record_size)
+                    {
+                        const Entry *entry = reinterpret_cast<const Entry *>(bytes);
+                        if (entry->size.load(std::memory_order_acquire) != record_size)
+                        {
+                            break;
+                        }
+                        entries.push_back(entry);
+                    }
+                }
+
+                valid = true;
+                std::stable_sort(entries.begin(), entries.end(), [](const Entry *left, const Entry *right)
+                {
+                    return left->timestamp < right->timestamp;
+                });
+            }
+
+            Replayer(const Replayer &other) = delete;
+            Replayer &operator=(const Replayer &other) = delete;
+
+            /**
+             * Destructor.
+             */
+            ~Replayer()
+            {
+                if (base != nullptr)
+                {
+                    ::munmap(const_cast<char *>(base), mapped_size);
+                }
+            }
+
+            /**
+             * Determine whether the file is a journal of this signature.
+             *
+             * @return Returns true if the file is a journal of this signature, else false.
+             */
+            explicit operator bool() const
+            {
+                return valid;
+            }
+
+            /**
+             * Returns the number of records.
+             *
+             * @return The number of records.
+             */
+            size_t size() const
+            {
+                return entries.size();
+            }
+
+            /**
+             * Invoke every record, in order, as fast as possible.  A record of an unregistered type terminates.
+             *
+             * @return Returns the number of records invoked.
+             */
+            size_t replay() const
+            {
+                DelegateType delegate;
+                for (const Entry *entry : entries)
+                {
+                    const typename Registry::Record *type = Registry::find(entry->id);
+                    if (type == nullptr)
+                    {
+                        std::terminate();
+                    }
+
+                    type->restore(entry->bytes, delegate);
+                    invoke(delegate, reinterpret_cast<const char *>(entry), std::index_sequence_for<Arguments...>());
+                }
+
+                return entries.size();
+            }
+
+        private:
+            /**
+             * Invoke a delegate with a record's arguments.
+             *
+             * @param delegate The delegate.
+             * @param bytes The record.
+             */
+            template<size_t... Indices>
+            static void invoke(const DelegateType &delegate, const char *bytes, std::index_sequence<Indices...>)
+            {
+                delegate(load<std::decay_t<Arguments>>(bytes + layout[Indices])...);
+            }
+
+            /** The mapped file. */
+            const char *base = nullptr;
+
+            /** The size of the mapped file. */
+            size_t mapped_size = 0;
+
+            /** Whether the file is a journal of this signature. */
+            bool valid = false;
+
+            /** The complete records, in replay order. */
+            std::vector<const Entry *> entries;
+        };
+    };
+
+    #ifdef DELEGATE_JOURNAL_BLOCK_SIZE_UNDEF
+     #undef DELEGATE_JOURNAL_BLOCK_SIZE
+     #undef DELEGATE_JOURNAL_BLOCK_SIZE_UNDEF
+    #endif
+}
@@ -0,0 +1,211 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <atomic>
+#include <exception>
+#include <utility>
+#include <dlfcn.h>
+#include "delegate.h"
+
+namespace delegate
+{
+    /**
+     * Delegate bound to a symbol in a shared library (e.g. a plugin entry point) which is only looked up when first
+     * called, so loading a plugin with many entry points doesn't pay for a dlsym per entry point.
+     *
+     * Like a delegate, it calls through a trampoline.  The first trampoline looks the symbol up, stores the function
+     * and replaces itself with one calling the function directly, so later calls have no check.  Both are atomic,
+     * and concurrent first calls may each look the symbol up and store the same function, so first calls are
+     * thread-safe without a lock.  Calling a symbol which can't be found terminates - call resolve() first to check.
+     *
+     * Lazy delegates are neither copyable nor movable, because the delegates made by get_delegate() refer to them.
+     * Link with -ldl before glibc 2.34.
+     *
+     * Example:
+     *      void *plugin = dlopen("libplugin.so", RTLD_NOW);
+     *      static delegate::LazyDelegate<int, const char *> on_command(plugin, "plugin_on_command");
+     *      on_command("status");
+     *
+     * @tparam Result The function return type.
+     * @tparam Arguments The function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    class LazyDelegate
+    {
+    public:
+        /** The function pointer type of the symbol. */
+        using Function = Result (*)(Arguments...);
+
+        /** The delegate type made by get_delegate(). */
+        using DelegateType = Delegate<Result, Arguments...>;
+
+        /**
+         * Constructor.  Doesn't look the symbol up.
+         *
+         * @param handle The library, from dlopen (or RTLD_DEFAULT), which must stay open.
+         * @param name The symbol name, which must outlive the delegate (e.g. a string literal).
+         */
+        LazyDelegate(void *handle, const char *name)
+            : call(&call_unresolved), function(nullptr), handle(handle), name(name)
+        {
+        }
+
+        LazyDelegate(const LazyDelegate &other) = delete;
+        LazyDelegate &operator=(const LazyDelegate &other) = delete;
+
+        /**
+         * Call the function, looking it up first if this is the first call.
+         *
+         * @param arguments The arguments to pass through to the function.
+         *
+         * @return Returns the Result type.
+         */
+        Result operator()(Arguments... arguments) const
+        {
+            return call.load(std::memory_order_acquire)(*this, std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * Look the symbol up now, if it hasn't been already.
+         *
+         * @return Returns true if the symbol was found, else false.
+         */
+        bool resolve() const
+        {
+            return lookup() != nullptr;
+        }
+
+        /**
+         * Determine whether the symbol has been looked up (and found).
+         *
+         * @return Returns true if the symbol has been found, else false.
+         */
+        bool resolved() const
+        {
+            return function.load(std::memory_order_acquire) != nullptr;
+        }
+
+        /**
+         * Returns a delegate calling the function.  Once the symbol is resolved the delegate calls the function
+         * directly.  Before then it calls this lazy delegate, which must outlive it, and keeps doing so after the
+         * symbol is found: each call then costs two indirect calls (the delegate's and this trampoline's) plus an
+         * atomic load, so call resolve() first where the delegate is called often.
+         *
+         * @return The delegate.
+         */
+        DelegateType get_delegate() const
+        {
+            const Function found = function.load(std::memory_order_acquire);
+            if (found)
+            {
+                return DelegateType(found);
+            }
+
+            return DelegateType([this](Arguments... arguments)
+            {
+                return (*this)(std::forward<Arguments>(arguments)...);
+            });
+        }
+
+        /**
+         * Returns the symbol name.
+         *
+         * @return The name.
+         */
+        const char *get_name() const
+        {
+            return name;
+        }
+
+    private:
+        /** The type-erased call function. */
+        using Call = Result (*)(const LazyDelegate &lazy, Arguments&&... arguments);
+
+        /**
+         * Look the symbol up if needed, then publish the function and the trampoline calling it.
+         *
+         * @return Returns the function, or nullptr if the symbol can't be found.
+         */
+        Function lookup() const
+        {
+            Function found = function.load(std::memory_order_acquire);
+            if (!found)
+            {
+                found = reinterpret_cast<Function>(dlsym(handle, name));
+                if (found)
+                {
+                    function.store(found, std::memory_order_release);
+                    call.store(&call_resolved, std::memory_order_release);
+                }
+            }
+
+            return found;
+        }
+
+        /**
+         * The first trampoline: look the symbol up and call it.
+         *
+         * @param lazy The lazy delegate.
+         * @param arguments The arguments to pass through to the function.
+         *
+         * @return Returns the Result type.
+         */
+        static Result call_unresolved(const LazyDelegate &lazy, Arguments&&... arguments)
+        {
+            const Function found = lazy.lookup();
+            if (!found)
+            {
+                // The symbol doesn't exist.
+                std::terminate();
+            }
+
+            return found(std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * The trampoline once the symbol has been found: call it.
+         *
+         * @param lazy The lazy delegate.
+         * @param arguments The arguments to pass through to the function.
+         *
+         * @return Returns the Result type.
+         */
+        static Result call_resolved(const LazyDelegate &lazy, Arguments&&... arguments)
+        {
+            // Ordered by the acquire of call.
+            return lazy.function.load(std::memory_order_relaxed)(std::forward<Arguments>(arguments)...);
+        }
+
+        /** The trampoline. */
+        mutable std::atomic<Call> call;
+
+        /** The function, once found. */
+        mutable std::atomic<Function> function;
+
+        /** The library. */
+        void *handle;
+
+        /** The symbol name. */
+        const char *name;
+    };
+}
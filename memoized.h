@@ -0,0 +1,239 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <array>
+#include <optional>
+#include <tuple>
+#include <utility>
+#include "delegate.h"
+
+namespace delegate
+{
+    template<typename DelegateType, size_t capacity>
+    class Memoized;
+
+    /**
+     * Memoizing wrapper for delegates which are pure functions of their (hashable, equality comparable) arguments.
+     * Results are kept in a fixed-capacity cache inside the wrapper, so like the delegate itself it never allocates.
+     *
+     * The cache is open-addressed: a call probes a small window of slots starting at the hash of its arguments.  When
+     * the window is full, an entry is evicted with the CLOCK algorithm (entries inserted or hit since the hand last
+     * passed them get a second chance).  Entries are only ever replaced, never removed, so a probe can stop at the
+     * first empty slot.
+     *
+     * Only delegates wrapped in a Memoized pay for the cache.  Counters are plain integers - use one instance per
+     * thread.
+     *
+     * Example:
+     *      delegate::Memoized<delegate::Delegate<double, int, int>, 64> price(&price_option);
+     *      price(100, 5);
+     *      price(100, 5);  // Cached.
+     *
+     * @tparam DelegateType The delegate type to memoize.
+     * @tparam capacity The number of results cached.
+     */
+    template<template<typename, typename...> class DelegateType, typename Result, typename... Arguments,
+             size_t capacity>
+    class Memoized<DelegateType<Result, Arguments...>, capacity>
+    {
+    public:
+        static_assert(!std::is_void_v<Result>, "There is no result to memoize.");
+        static_assert(capacity > 0, "The cache must hold at least one result.");
+
+        /** The number of slots a call probes before evicting. */
+        static constexpr size_t probe_size = capacity < 8 ? capacity : 8;
+
+        /** The cache key - copies of the arguments. */
+        using Key = std::tuple<std::decay_t<Arguments>...>;
+
+        /** Default constructor. Like the delegate, legal but uncallable. */
+        Memoized() = default;
+
+        /**
+         * Constructor.
+         *
+         * @param delegate The delegate to memoize.
+         */
+        Memoized(DelegateType<Result, Arguments...> delegate)
+            : delegate(std::move(delegate))
+        {
+        }
+
+        /**
+         * Return the cached result for the arguments, calling the delegate (and caching its result) on a miss.
+         *
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        Result operator()(Arguments... arguments)
+        {
+            Key key(arguments...);
+            const size_t hash = hash_key(key, std::index_sequence_for<Arguments...>());
+            const size_t start = hash % capacity;
+
+            for (size_t probe = 0; probe < probe_size; probe++)
+            {
+                Entry &entry = entries[(start + probe) % capacity];
+                if (!entry.value)
+                {
+                    return insert(entry, hash, std::move(key), std::forward<Arguments>(arguments)...);
+                }
+
+                if (entry.hash == hash && entry.value->first == key)
+                {
+                    hit_count++;
+                    entry.referenced = true;
+                    return entry.value->second;
+                }
+            }
+
+            return insert(evict(start), hash, std::move(key), std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * Like std::function, returns whether it's safe to call this wrapper.
+         *
+         * @return True if the wrapped delegate is safe to call, else false.
+         */
+        explicit operator bool() const
+        {
+            return !!delegate;
+        }
+
+        /**
+         * Returns the number of calls answered from the cache.
+         *
+         * @return The number of cache hits.
+         */
+        size_t hits() const
+        {
+            return hit_count;
+        }
+
+        /**
+         * Returns the number of calls which called the delegate.
+         *
+         * @return The number of cache misses.
+         */
+        size_t misses() const
+        {
+            return miss_count;
+        }
+
+        /** Empty the cache and reset the counters. */
+        void clear()
+        {
+            entries = {};
+            hit_count = 0;
+            miss_count = 0;
+        }
+
+    private:
+        /** A cached result. */
+        struct Entry
+        {
+            /** The hash of the key, checked before comparing keys. */
+            size_t hash = 0;
+
+            /** Whether the entry was inserted or hit since the CLOCK hand last passed it. */
+            bool referenced = false;
+
+            /** The key and result, empty if the slot is unused. */
+            std::optional<std::pair<Key, Result>> value;
+        };
+
+        /**
+         * Hash the key, combining std::hash of each argument.
+         *
+         * @param key The key to hash.
+         *
+         * @return Returns the hash.
+         */
+        template<size_t... index>
+        static size_t hash_key(const Key &key, std::index_sequence<index...>)
+        {
+            size_t hash = 0;
+            (..., (hash = hash_combine(hash, std::hash<std::tuple_element_t<index, Key>>()(std::get<index>(key)))));
+
+            return hash;
+        }
+
+        /**
+         * Call the delegate and cache its result.
+         *
+         * @param entry The entry to store the result to.
+         * @param hash The hash of the key.
+         * @param key The key to store.
+         * @param arguments The arguments to pass through to the delegate.
+         *
+         * @return Returns the Result type.
+         */
+        Result insert(Entry &entry, size_t hash, Key &&key, Arguments&&... arguments)
+        {
+            miss_count++;
+            entry.hash = hash;
+            entry.referenced = true;
+            entry.value.emplace(std::move(key), delegate(std::forward<Arguments>(arguments)...));
+
+            return entry.value->second;
+        }
+
+        /**
+         * Pick the entry to evict from the (full) probe window with the CLOCK algorithm.
+         *
+         * @param start The first slot of the probe window.
+         *
+         * @return Returns the entry to replace.
+         */
+        Entry &evict(size_t start)
+        {
+            while (true)
+            {
+                Entry &entry = entries[(start + hand) % capacity];
+                hand = (hand + 1) % probe_size;
+                if (!entry.referenced)
+                {
+                    return entry;
+                }
+
+                entry.referenced = false;
+            }
+        }
+
+        /** The memoized delegate. */
+        DelegateType<Result, Arguments...> delegate;
+
+        /** The cache. */
+        std::array<Entry, capacity> entries = {};
+
+        /** CLOCK hand, as an offset into the probe window. */
+        size_t hand = 0;
+
+        /** Calls answered from the cache. */
+        size_t hit_count = 0;
+
+        /** Calls which called the delegate. */
+        size_t miss_count = 0;
+    };
+}
@@ -0,0 +1,356 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <iterator>
+#include <vector>
+#include "delegate.h"
+
+namespace delegate
+{
+    /**
+     * Signal with Delegate slots.  Connecting returns a scoped Connection, which disconnects the slot when it is
+     * destroyed.
+     *
+     * Emission is reentrancy-safe without copying the slot list: slots may connect and disconnect (themselves or
+     * others) and emit again while being called.  A slot disconnected during emission is only marked dead, so it is
+     * skipped by the rest of the emission, and the dead slots are compacted away at the end of the outermost
+     * emission.  Slots connected during emission are held back until then as well, so they are first called by the
+     * next emission and the slot list never reallocates underneath a running slot.  Emission itself never allocates.
+     *
+     * Arguments are passed to each slot as lvalues, since every slot receives the same ones.  Signals are neither
+     * copyable nor movable (connections point to them), nor thread-safe.
+     *
+     * Example:
+     *      delegate::Signal<int> on_fill;
+     *      delegate::Signal<int>::Connection connection = on_fill.connect([](int quantity){...});
+     *      on_fill(100);
+     *
+     * @tparam Arguments The slot function arguments.
+     */
+    template<typename... Arguments>
+    class Signal
+    {
+    public:
+        /** The slot delegate type. */
+        using Slot = Delegate<void, Arguments...>;
+
+        /** Scoped connection of a slot to a signal.  Disconnects the slot on destruction, unless released. */
+        class Connection
+        {
+        public:
+            /** Default constructor. Not connected to anything. */
+            Connection() = default;
+
+            /**
+             * Move constructor.
+             *
+             * @param other The connection to move from.
+             */
+            Connection(Connection &&other) noexcept
+                : signal(other.signal)
+                , id(other.id)
+            {
+                other.signal = nullptr;
+                retarget();
+            }
+
+            /**
+             * Move assignment operator.  Disconnects whatever this was connected to.
+             *
+             * @param other The connection to move from.
+             *
+             * @return Returns a reference to this.
+             */
+            Connection &operator=(Connection &&other) noexcept
+            {
+                if (&other == this)
+                {
+                    return *this;
+                }
+
+                disconnect();
+                signal = other.signal;
+                id = other.id;
+                other.signal = nullptr;
+                retarget();
+
+                return *this;
+            }
+
+            /** Destructor. Disconnects the slot. */
+            ~Connection()
+            {
+                disconnect();
+            }
+
+            /** Disconnect the slot.  Safe to call from within an emission, including from the slot itself. */
+            void disconnect()
+            {
+                if (signal != nullptr)
+                {
+                    signal->disconnect(id);
+                    signal = nullptr;
+                }
+            }
+
+            /** Give up ownership of the connection, leaving the slot connected for the lifetime of the signal. */
+            void release()
+            {
+                if (signal != nullptr)
+                {
+                    signal->find(id)->connection = nullptr;
+                    signal = nullptr;
+                }
+            }
+
+            /**
+             * Returns whether the slot is still connected.
+             *
+             * @return True if connected, else false.
+             */
+            bool connected() const
+            {
+                return signal != nullptr;
+            }
+
+            Connection(const Connection &other) = delete;
+            Connection &operator=(const Connection &other) = delete;
+
+        private:
+            friend class Signal;
+
+            /**
+             * Constructor.
+             *
+             * @param signal The signal the slot is connected to.
+             * @param id The slot id.
+             */
+            Connection(Signal *signal, size_t id)
+                : signal(signal)
+                , id(id)
+            {
+                retarget();
+            }
+
+            /** Point the slot at this connection. */
+            void retarget()
+            {
+                if (signal != nullptr)
+                {
+                    signal->find(id)->connection = this;
+                }
+            }
+
+            /** The signal the slot is connected to, or nullptr. */
+            Signal *signal = nullptr;
+
+            /** The slot id. */
+            size_t id = 0;
+        };
+
+        /** Default constructor. */
+        Signal() = default;
+
+        /** Destructor. Leaves outstanding connections disconnected. */
+        ~Signal()
+        {
+            for (Entry &entry : entries)
+            {
+                detach(entry);
+            }
+
+            for (Entry &entry : pending)
+            {
+                detach(entry);
+            }
+        }
+
+        /**
+         * Connect a slot.
+         *
+         * @param slot The slot to connect.
+         *
+         * @return Returns the connection, which disconnects the slot when destroyed.
+         */
+        [[nodiscard]] Connection connect(Slot slot)
+        {
+            const size_t id = next_id++;
+
+            // Connecting during emission must not reallocate the entries being called.
+            (emit_depth == 0 ? entries : pending).push_back({std::move(slot), id, nullptr, true});
+            live_count++;
+
+            return Connection(this, id);
+        }
+
+        /**
+         * Call every connected slot.
+         *
+         * @param arguments The arguments to pass to each slot.
+         */
+        void operator()(Arguments... arguments)
+        {
+            emit_depth++;
+
+            // Entries are neither added nor erased until the outermost emission ends.
+            for (const Entry &entry : entries)
+            {
+                if (entry.live)
+                {
+                    entry.slot(arguments...);
+                }
+            }
+
+            if (--emit_depth == 0)
+            {
+                compact();
+            }
+        }
+
+        /**
+         * Returns the number of connected slots.
+         *
+         * @return The number of connected slots.
+         */
+        size_t size() const
+        {
+            return live_count;
+        }
+
+        /**
+         * Returns whether there are no connected slots.
+         *
+         * @return True if there are no connected slots, else false.
+         */
+        bool empty() const
+        {
+            return live_count == 0;
+        }
+
+        Signal(const Signal &other) = delete;
+        Signal &operator=(const Signal &other) = delete;
+
+    private:
+        /** A connected slot. */
+        struct Entry
+        {
+            /** The slot. */
+            Slot slot;
+
+            /** The slot id - ids increase, so entries are sorted by id. */
+            size_t id;
+
+            /** The owning connection, or nullptr if released. */
+            Connection *connection;
+
+            /** Whether the slot is still connected (false once disconnected during emission). */
+            bool live;
+        };
+
+        /**
+         * Find the entry for a slot.
+         *
+         * @param id The slot id.
+         *
+         * @return Returns the entry.
+         */
+        Entry *find(size_t id)
+        {
+            auto found = std::lower_bound(entries.begin(), entries.end(), id,
+                                          [](const Entry &entry, size_t id){return entry.id < id;});
+            if (found != entries.end() && found->id == id)
+            {
+                return &*found;
+            }
+
+            return &*std::find_if(pending.begin(), pending.end(), [id](const Entry &entry){return entry.id == id;});
+        }
+
+        /**
+         * Disconnect a slot, erasing it unless emission is in progress (in which case it is marked dead).
+         *
+         * @param id The slot id.
+         */
+        void disconnect(size_t id)
+        {
+            Entry *entry = find(id);
+            entry->live = false;
+            entry->connection = nullptr;
+            live_count--;
+
+            if (emit_depth == 0)
+            {
+                compact();
+            }
+        }
+
+        /** Erase the dead entries and take on the ones connected during emission. */
+        void compact()
+        {
+            if (live_count != entries.size() + pending.size())
+            {
+                entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                             [](const Entry &entry){return !entry.live;}),
+                              entries.end());
+                pending.erase(std::remove_if(pending.begin(), pending.end(),
+                                             [](const Entry &entry){return !entry.live;}),
+                              pending.end());
+            }
+
+            if (!pending.empty())
+            {
+                std::move(pending.begin(), pending.end(), std::back_inserter(entries));
+                pending.clear();
+            }
+        }
+
+        /**
+         * Leave an entry's connection (if any) disconnected.
+         *
+         * @param entry The entry.
+         */
+        static void detach(Entry &entry)
+        {
+            if (entry.connection != nullptr)
+            {
+                entry.connection->signal = nullptr;
+            }
+        }
+
+        /** Connected slots, sorted by id. */
+        std::vector<Entry> entries;
+
+        /** Slots connected during emission, sorted by id. */
+        std::vector<Entry> pending;
+
+        /** Number of connected (live) slots. */
+        size_t live_count = 0;
+
+        /** The id of the next slot to connect. */
+        size_t next_id = 0;
+
+        /** Emission nesting depth. */
+        size_t emit_depth = 0;
+    };
+}
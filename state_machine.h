@@ -0,0 +1,221 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <array>
+#include <exception>
+#include <utility>
+#include "delegate.h"
+
+namespace delegate
+{
+    /**
+     * Table-driven finite state machine.  Transitions live in a dense (state, event) table shared by any number of
+     * machines (e.g. one per session), and each machine is just its current state.
+     *
+     * Every table entry holds a guard and an action, so dispatching an event is one table lookup and two calls: the
+     * guard decides whether the transition is taken, then the action runs and the machine moves to the target state.
+     * Unset entries have a guard that rejects, so unhandled events need no extra check.  Guards and actions may be
+     * any delegate, including plain functions bound at compile time.
+     *
+     * Actions must not dispatch to their own machine.
+     *
+     * Example:
+     *      enum class State {idle, connected, count};
+     *      enum class Event {connect, close, count};
+     *      using Machine = delegate::StateMachine<State, Event, Session &>;
+     *      Machine::Table table;
+     *      table.set(State::idle, Event::connect, State::connected, &on_connect, [](Session &session){...});
+     *      Machine machine(table, State::idle);
+     *      machine.dispatch(Event::connect, session);
+     *
+     * @tparam State The state enum, with a last enumerator named count.
+     * @tparam Event The event enum, with a last enumerator named count.
+     * @tparam Arguments The arguments passed to guards and actions.
+     */
+    template<typename State, typename Event, typename... Arguments>
+    class StateMachine
+    {
+    public:
+        /** Decides whether a transition is taken. */
+        using Guard = Delegate<bool, Arguments...>;
+
+        /** Runs when a transition is taken. */
+        using Action = Delegate<void, Arguments...>;
+
+        /** The number of states. */
+        static constexpr size_t state_count = size_t(State::count);
+
+        /** The number of events. */
+        static constexpr size_t event_count = size_t(Event::count);
+
+        /** The transitions of a state machine. */
+        class Table
+        {
+        public:
+            /** Default constructor.  Every event is unhandled in every state. */
+            Table()
+            {
+                transitions.fill(Transition{Guard(&reject), Action(&ignore), State()});
+            }
+
+            /**
+             * Set the transition taken when an event arrives in a state.  An out of range state or event terminates.
+             *
+             * @param from The state.
+             * @param event The event.
+             * @param to The target state.
+             * @param action Runs when the transition is taken.
+             * @param guard Decides whether the transition is taken.
+             */
+            void set(State from, Event event, State to, Action action = Action(&ignore), Guard guard = Guard(&accept))
+            {
+                if (size_t(from) >= state_count || size_t(to) >= state_count || size_t(event) >= event_count)
+                {
+                    std::terminate();
+                }
+
+                transitions[index(from, event)] = Transition{std::move(guard), std::move(action), to};
+            }
+
+            /**
+             * Make an event unhandled in a state.
+             *
+             * @param from The state.
+             * @param event The event.
+             */
+            void clear(State from, Event event)
+            {
+                set(from, event, State(), Action(&ignore), Guard(&reject));
+            }
+
+        private:
+            friend class StateMachine;
+
+            /** A table entry. */
+            struct Transition
+            {
+                Guard guard;
+                Action action;
+                State target;
+            };
+
+            /**
+             * Returns the table index of a state and event.
+             *
+             * @param from The state.
+             * @param event The event.
+             *
+             * @return The index.
+             */
+            static size_t index(State from, Event event)
+            {
+                return size_t(from) * event_count + size_t(event);
+            }
+
+            /** The transitions, by state then event. */
+            std::array<Transition, state_count * event_count> transitions;
+        };
+
+        /**
+         * Constructor.
+         *
+         * @param table The transitions, which must outlive the machine.
+         * @param initial The initial state.
+         */
+        StateMachine(const Table &table, State initial) : table(&table), current(initial)
+        {
+        }
+
+        /**
+         * Dispatch an event: if the current state's guard for it accepts, run the action and move to the target
+         * state.  An out of range event terminates.
+         *
+         * @param event The event.
+         * @param arguments The arguments to pass to the guard and action.
+         *
+         * @return Returns true if a transition was taken, false if the event is unhandled or the guard rejected it.
+         */
+        bool dispatch(Event event, Arguments... arguments)
+        {
+            if (size_t(event) >= event_count)
+            {
+                std::terminate();
+            }
+
+            const typename Table::Transition &transition = table->transitions[Table::index(current, event)];
+            if (!transition.guard(arguments...))
+            {
+                return false;
+            }
+
+            transition.action(std::forward<Arguments>(arguments)...);
+            current = transition.target;
+
+            return true;
+        }
+
+        /**
+         * Returns the current state.
+         *
+         * @return The state.
+         */
+        State state() const
+        {
+            return current;
+        }
+
+        /**
+         * Force the current state, e.g. to reset a machine.
+         *
+         * @param state The state.
+         */
+        void reset(State state)
+        {
+            current = state;
+        }
+
+    private:
+        /** The guard of unset transitions. */
+        static bool reject(Arguments...)
+        {
+            return false;
+        }
+
+        /** The guard of transitions set without one. */
+        static bool accept(Arguments...)
+        {
+            return true;
+        }
+
+        /** The action of transitions set without one. */
+        static void ignore(Arguments...)
+        {
+        }
+
+        /** The transitions. */
+        const Table *table;
+
+        /** The current state. */
+        State current;
+    };
+}
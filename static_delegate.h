@@ -0,0 +1,352 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include "delegate.h"
+
+namespace delegate
+{
+    template<typename DelegateType, typename... Functors>
+    class StaticDelegate;
+
+    /**
+     * Delegate over a closed set of functor types, known at compile time.  The functor is stored in place with a
+     * small index of its type, and calls compare the index against each type in turn and call the functor directly,
+     * so small handlers are inlined at the call site instead of being called through a trampoline (the compiler
+     * turns longer chains into a jump table).  Any other functor is held in a fallback delegate, which is called
+     * indirectly as usual, so the set only needs to cover the common cases.
+     *
+     * List functor types (e.g. lambdas or function objects) rather than function pointers - a function pointer is
+     * still called indirectly.  The storage is large enough for the fallback delegate and every listed type.
+     *
+     * Example:
+     *      const auto on_add = [](int value){return value + 1;};
+     *      using Handler = delegate::StaticDelegate<delegate::Delegate<int, int>, decltype(on_add)>;
+     *      Handler handler = on_add;
+     *      handler(17);
+     *
+     * @tparam DelegateType The fallback delegate type, which also gives the signature.
+     * @tparam Functors The functor types stored and called directly.
+     */
+    template<template<typename, typename...> class DelegateType, typename Result, typename... Arguments,
+             typename... Functors>
+    class StaticDelegate<DelegateType<Result, Arguments...>, Functors...>
+    {
+    public:
+        /** The delegate holding functors not in Functors. */
+        using Fallback = DelegateType<Result, Arguments...>;
+
+        /** The index of the fallback delegate. */
+        static constexpr size_t fallback = sizeof...(Functors);
+
+        static_assert(fallback < UINT8_MAX, "Too many functor types.");
+        static_assert((std::is_invocable_r_v<Result, Functors &, Arguments...> && ...),
+                      "Every functor type must be callable with the delegate signature.");
+
+        /** Default constructor.  Holds an empty fallback delegate. */
+        StaticDelegate() : which(fallback)
+        {
+            ::new (&storage) Fallback();
+        }
+
+        /**
+         * Constructor from a functor, stored in place if its type is listed, else in the fallback delegate.
+         *
+         * @tparam T The functor type.
+         * @param functor The functor.
+         */
+        template<typename T, typename = std::enable_if_t<!std::is_same_v<std::decay_t<T>, StaticDelegate>>>
+        StaticDelegate(T &&functor) : which(uint8_t(index_of<std::decay_t<T>>()))
+        {
+            using Stored = std::conditional_t<index_of<std::decay_t<T>>() == fallback, Fallback, std::decay_t<T>>;
+            ::new (&storage) Stored(std::forward<T>(functor));
+        }
+
+        /**
+         * Copy constructor.
+         *
+         * @param other The delegate to copy.
+         */
+        StaticDelegate(const StaticDelegate &other)
+        {
+            copy_from(other);
+        }
+
+        /**
+         * Move constructor.  The other delegate holds a moved from functor of the same type.
+         *
+         * @param other The delegate to move.
+         */
+        StaticDelegate(StaticDelegate &&other) noexcept
+        {
+            move_from(other);
+        }
+
+        /** Destructor. */
+        ~StaticDelegate()
+        {
+            destroy();
+        }
+
+        /**
+         * Copy assignment.
+         *
+         * @param other The delegate to copy.
+         *
+         * @return Returns this delegate.
+         */
+        StaticDelegate &operator=(const StaticDelegate &other)
+        {
+            if (this != &other)
+            {
+                destroy();
+                copy_from(other);
+            }
+
+            return *this;
+        }
+
+        /**
+         * Move assignment.
+         *
+         * @param other The delegate to move.
+         *
+         * @return Returns this delegate.
+         */
+        StaticDelegate &operator=(StaticDelegate &&other) noexcept
+        {
+            if (this != &other)
+            {
+                destroy();
+                move_from(other);
+            }
+
+            return *this;
+        }
+
+        /**
+         * Call the functor, directly if its type is listed.
+         *
+         * @param arguments The arguments to pass through to the functor.
+         *
+         * @return Returns the Result type.
+         */
+        Result operator()(Arguments... arguments) const
+        {
+            return call<0>(std::forward<Arguments>(arguments)...);
+        }
+
+        /**
+         * Determine whether a functor is held.
+         *
+         * @return Returns true if a listed functor, or a non-empty fallback delegate, is held.
+         */
+        explicit operator bool() const
+        {
+            return which != fallback || bool(get<Fallback>());
+        }
+
+        /**
+         * Returns the index of the held functor's type in Functors, or fallback.
+         *
+         * @return The index.
+         */
+        size_t index() const
+        {
+            return which;
+        }
+
+        /**
+         * Get the held functor, if it is a T.
+         *
+         * @tparam T The functor type (or Fallback).
+         *
+         * @return A pointer to the held functor, or nullptr if the held functor is not a T.
+         */
+        template<typename T>
+        T *target()
+        {
+            if constexpr (index_of<T>() == fallback && !std::is_same_v<T, Fallback>)
+            {
+                return nullptr;
+            }
+            else
+            {
+                return which == index_of<T>() ? &get<T>() : nullptr;
+            }
+        }
+
+        /**
+         * Get the held functor, if it is a T.
+         *
+         * @tparam T The functor type (or Fallback).
+         *
+         * @return A pointer to the held functor, or nullptr if the held functor is not a T.
+         */
+        template<typename T>
+        const T *target() const
+        {
+            return const_cast<StaticDelegate *>(this)->template target<T>();
+        }
+
+    private:
+        /** The functor type at an index. */
+        template<size_t index>
+        using Functor = std::tuple_element_t<index, std::tuple<std::remove_cv_t<Functors>..., Fallback>>;
+
+        /**
+         * Returns the index of a functor type (ignoring const), or fallback if it isn't listed.
+         *
+         * @tparam T The functor type.
+         *
+         * @return The index.
+         */
+        template<typename T>
+        static constexpr size_t index_of()
+        {
+            constexpr bool matches[] = {std::is_same_v<std::remove_cv_t<T>, std::remove_cv_t<Functors>>..., true};
+            size_t index = 0;
+            while (!matches[index])
+            {
+                index++;
+            }
+
+            return index;
+        }
+
+        /**
+         * Returns the storage as a functor type.
+         *
+         * @tparam T The functor type.
+         *
+         * @return A reference to the functor.
+         */
+        template<typename T>
+        T &get() const
+        {
+            return (T &)(storage);
+        }
+
+        /**
+         * Check the held functor's type against the type at index, calling it directly on a match, else move on to
+         * the next type (and eventually the fallback delegate).
+         *
+         * @tparam index The index of the functor type to check.
+         * @param arguments The arguments to pass through to the functor.
+         *
+         * @return Returns the Result type.
+         */
+        template<size_t index>
+        Result call(Arguments&&... arguments) const
+        {
+            if constexpr (index == fallback)
+            {
+                return get<Fallback>()(std::forward<Arguments>(arguments)...);
+            }
+            else
+            {
+                if (which == index)
+                {
+                    return get<Functor<index>>()(std::forward<Arguments>(arguments)...);
+                }
+
+                return call<index + 1>(std::forward<Arguments>(arguments)...);
+            }
+        }
+
+        /**
+         * Call a visitor with the held functor.
+         *
+         * @tparam index The index of the functor type to check.
+         * @tparam Visitor The visitor type.
+         * @param visitor Called with a reference to the functor.
+         */
+        template<size_t index = 0, typename Visitor>
+        void visit(Visitor &&visitor) const
+        {
+            if constexpr (index == fallback)
+            {
+                visitor(get<Fallback>());
+            }
+            else if (which == index)
+            {
+                visitor(get<Functor<index>>());
+            }
+            else
+            {
+                visit<index + 1>(std::forward<Visitor>(visitor));
+            }
+        }
+
+        /**
+         * Copy another delegate's functor into the (unused) storage.
+         *
+         * @param other The delegate to copy.
+         */
+        void copy_from(const StaticDelegate &other)
+        {
+            which = other.which;
+            other.visit([this](auto &functor)
+            {
+                ::new (&storage) std::decay_t<decltype(functor)>(functor);
+            });
+        }
+
+        /**
+         * Move another delegate's functor into the (unused) storage.
+         *
+         * @param other The delegate to move.
+         */
+        void move_from(StaticDelegate &other)
+        {
+            which = other.which;
+            other.visit([this](auto &functor)
+            {
+                ::new (&storage) std::decay_t<decltype(functor)>(std::move(functor));
+            });
+        }
+
+        /** Destroy the held functor. */
+        void destroy()
+        {
+            visit([](auto &functor)
+            {
+                using T = std::decay_t<decltype(functor)>;
+                functor.~T();
+            });
+        }
+
+        /** The storage, large enough for any of the functor types. */
+        alignas(std::max({alignof(Fallback), alignof(Functors)...}))
+        std::array<char, std::max({sizeof(Fallback), sizeof(Functors)...})> storage;
+
+        /** The index of the held functor's type. */
+        uint8_t which;
+    };
+}
@@ -0,0 +1,324 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <array>
+#include <cstdint>
+#include <exception>
+#include <string_view>
+#include <string.h>
+#include "delegate.h"
+
+namespace delegate
+{
+    /**
+     * Fixed set of handlers keyed by string (e.g. admin commands, FIX message types), found through a perfect hash
+     * built at compile time.  A lookup is one hash of the key, one key comparison and, by the caller, one call.
+     *
+     * The hash is hash-and-displace: the key's hash picks a bucket, and the bucket's displacement (found when the
+     * table is built) moves its keys to slots no other key uses.  Both come from the one hash of the key.  Tables
+     * are literal types built by a constexpr constructor, so a constexpr table is built by the compiler and lives in
+     * read-only data.  Duplicate keys don't compile.
+     *
+     * Handlers are functions or capture-less lambdas, stored as function pointers: a delegate holding a function
+     * pointer would call through its trampoline as well, and isn't a literal type.  Construct a Delegate from a
+     * found handler where one is needed.
+     *
+     * Example:
+     *      using Commands = delegate::StringDispatch<void, Session &>;
+     *      static constexpr Commands::Table commands({
+     *          {"quit", &quit},
+     *          {"status", [](Session &session){...}}});
+     *      if (const auto handler = commands.find(name)) handler(session);
+     *
+     * @tparam Result The handler return type.
+     * @tparam Arguments The handler function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    class StringDispatch
+    {
+    public:
+        /** A handler function. */
+        using Function = Result (*)(Arguments...);
+
+        /** A handler: its key and function. */
+        struct Handler
+        {
+            /** The key the handler is found by. */
+            std::string_view key;
+
+            /** The handler, a function or capture-less lambda. */
+            Function function;
+        };
+
+        /**
+         * A perfect hash table of handlers.  The number of handlers is deduced from the constructor argument.
+         *
+         * @tparam count The number of handlers.
+         */
+        template<size_t count>
+        class Table
+        {
+        public:
+            static_assert(count > 0, "There must be at least one handler.");
+
+            /**
+             * Constructor.  Builds the perfect hash.
+             *
+             * @param handlers The handlers, with distinct keys.
+             */
+            constexpr explicit Table(const Handler (&handlers)[count]) : displacements(), slots()
+            {
+                const Placement placement = place(handlers);
+                displacements = placement.displacements;
+                for (size_t slot = 0; slot < capacity; slot++)
+                {
+                    const size_t owner = placement.owners[slot];
+                    slots[slot] = owner == count ? Slot{nullptr, size_t(-1), nullptr}
+                                                 : Slot{handlers[owner].key.data(), handlers[owner].key.size(),
+                                                        handlers[owner].function};
+                }
+            }
+
+            /**
+             * Find a handler by key.
+             *
+             * @param key The key.
+             *
+             * @return Returns the handler, or nullptr if no handler has the key.
+             */
+            Function find(std::string_view key) const
+            {
+                const uint64_t hash = hash_key(key);
+                const Slot &slot = slots[position(hash, displacements[hash & (bucket_count - 1)])];
+
+                return slot.size == key.size() && memcmp(slot.key, key.data(), key.size()) == 0 ? slot.function
+                                                                                                : nullptr;
+            }
+
+            /**
+             * Returns the number of handlers.
+             *
+             * @return The number of handlers.
+             */
+            static constexpr size_t size()
+            {
+                return count;
+            }
+
+        private:
+            /**
+             * Returns the smallest power of two at least as large as a value.
+             *
+             * @param value The value.
+             *
+             * @return The power of two.
+             */
+            static constexpr size_t round_up_pow2(size_t value)
+            {
+                size_t pow2 = 1;
+                while (pow2 < value)
+                {
+                    pow2 *= 2;
+                }
+
+                return pow2;
+            }
+
+            /**
+             * Returns the base two logarithm of a power of two.
+             *
+             * @param pow2 The power of two.
+             *
+             * @return The logarithm.
+             */
+            static constexpr unsigned log2(size_t pow2)
+            {
+                unsigned bits = 0;
+                while ((size_t(1) << bits) < pow2)
+                {
+                    bits++;
+                }
+
+                return bits;
+            }
+
+            /** The number of slots - at most half are used, which keeps finding displacements quick. */
+            static constexpr size_t capacity = round_up_pow2(2 * count);
+
+            /** The number of buckets, about two keys each. */
+            static constexpr size_t bucket_count = round_up_pow2((count + 1) / 2);
+
+            /** The number of bits in a slot position. */
+            static constexpr unsigned position_bits = log2(capacity);
+
+            /** The number of displacements tried per bucket before giving up. */
+            static constexpr uint32_t max_displacement = 1 << 16;
+
+            /** A slot.  Empty slots have a size no key has. */
+            struct Slot
+            {
+                const char *key;
+                size_t size;
+                Function function;
+            };
+
+            /** Where each bucket's keys go, found when the table is built. */
+            struct Placement
+            {
+                /** The displacement of each bucket. */
+                std::array<uint32_t, bucket_count> displacements;
+
+                /** The handler in each slot, or count if empty. */
+                std::array<size_t, capacity> owners;
+            };
+
+            /**
+             * Returns the slot of a key's hash under a displacement.
+             *
+             * @param hash The key's hash.
+             * @param displacement The displacement of the key's bucket.
+             *
+             * @return The slot.
+             */
+            static constexpr size_t position(uint64_t hash, uint32_t displacement)
+            {
+                return size_t(((hash ^ (displacement * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull) >>
+                              (64 - position_bits));
+            }
+
+            /**
+             * Find a displacement for every bucket, largest buckets first, so that no two keys share a slot.
+             *
+             * @param handlers The handlers.
+             *
+             * @return The placement.
+             */
+            static constexpr Placement place(const Handler (&handlers)[count])
+            {
+                std::array<uint64_t, count> hashes = {};
+                std::array<size_t, bucket_count> sizes = {};
+                size_t largest = 0;
+                for (size_t handler = 0; handler < count; handler++)
+                {
+                    for (size_t other = 0; other < handler; other++)
+                    {
+                        if (handlers[other].key == handlers[handler].key)
+                        {
+                            // Duplicate key.
+                            std::terminate();
+                        }
+                    }
+
+                    hashes[handler] = hash_key(handlers[handler].key);
+                    const size_t bucket_size = ++sizes[hashes[handler] & (bucket_count - 1)];
+                    largest = bucket_size > largest ? bucket_size : largest;
+                }
+
+                Placement placement = {};
+                for (size_t &owner : placement.owners)
+                {
+                    owner = count;
+                }
+
+                for (size_t bucket_size = largest; bucket_size > 0; bucket_size--)
+                {
+                    for (size_t bucket = 0; bucket < bucket_count; bucket++)
+                    {
+                        if (sizes[bucket] == bucket_size)
+                        {
+                            placement.displacements[bucket] = displace(hashes, bucket, placement.owners);
+                        }
+                    }
+                }
+
+                return placement;
+            }
+
+            /**
+             * Find a displacement putting a bucket's keys in free slots, and claim the slots.
+             *
+             * @param hashes The keys' hashes.
+             * @param bucket The bucket.
+             * @param owners The handler in each slot, updated.
+             *
+             * @return The displacement.
+             */
+            static constexpr uint32_t displace(const std::array<uint64_t, count> &hashes, size_t bucket,
+                                               std::array<size_t, capacity> &owners)
+            {
+                for (uint32_t displacement = 0; displacement < max_displacement; displacement++)
+                {
+                    bool placed = true;
+                    for (size_t handler = 0; handler < count && placed; handler++)
+                    {
+                        if ((hashes[handler] & (bucket_count - 1)) == bucket)
+                        {
+                            size_t &owner = owners[position(hashes[handler], displacement)];
+                            placed = owner == count;
+                            owner = placed ? handler : owner;
+                        }
+                    }
+
+                    if (placed)
+                    {
+                        return displacement;
+                    }
+
+                    // Release the slots claimed by this attempt.
+                    for (size_t &owner : owners)
+                    {
+                        owner = owner != count && (hashes[owner] & (bucket_count - 1)) == bucket ? count : owner;
+                    }
+                }
+
+                // No displacement found.
+                std::terminate();
+            }
+
+            /** The displacement of each bucket. */
+            std::array<uint32_t, bucket_count> displacements;
+
+            /** The slots. */
+            std::array<Slot, capacity> slots;
+        };
+
+    private:
+        /**
+         * Hash a key (FNV-1a, then mixed so the low bits can pick the bucket).
+         *
+         * @param key The key.
+         *
+         * @return The hash.
+         */
+        static constexpr uint64_t hash_key(std::string_view key)
+        {
+            uint64_t hash = 0xcbf29ce484222325ull;
+            for (const char character : key)
+            {
+                hash = (hash ^ uint8_t(character)) * 0x100000001b3ull;
+            }
+
+            return hash ^ (hash >> 29);
+        }
+    };
+}
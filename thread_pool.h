@@ -0,0 +1,205 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "delegate.h"
+
+namespace delegate
+{
+    /**
+     * Fixed-size pool of worker threads for splitting a range of work into chunks.  The calling thread works on the
+     * chunks too, and the pool is idle (blocked, not spinning) between jobs.
+     *
+     * Jobs from different threads are run one at a time.  A job must not start another job on the same pool.
+     */
+    class ThreadPool
+    {
+    public:
+        /** The job body, called with [begin, end) of each chunk. */
+        using Body = Delegate<void, size_t, size_t>;
+
+        /**
+         * Constructor.
+         *
+         * @param workers The number of worker threads (besides the threads starting jobs).
+         */
+        explicit ThreadPool(size_t workers = default_workers())
+        {
+            threads.reserve(workers);
+            for (size_t worker = 0; worker < workers; worker++)
+            {
+                threads.emplace_back([this](){work();});
+            }
+        }
+
+        /** Destructor.  Stops and joins the worker threads. */
+        ~ThreadPool()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+
+            wake.notify_all();
+            for (std::thread &thread : threads)
+            {
+                thread.join();
+            }
+        }
+
+        /**
+         * Returns the number of worker threads.
+         *
+         * @return The number of worker threads.
+         */
+        size_t size() const
+        {
+            return threads.size();
+        }
+
+        /**
+         * Split [0, count) into chunks and call the body for each one from the worker threads and the calling thread,
+         * returning once all of them are done.
+         *
+         * @param count The size of the range.
+         * @param chunk The (maximum) chunk size.
+         * @param body The job body.
+         */
+        void parallel_for(size_t count, size_t chunk, const Body &body)
+        {
+            std::lock_guard<std::mutex> job_lock(job_mutex);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job_body = &body;
+                job_count = count;
+                job_chunk = std::max<size_t>(chunk, 1);
+                next.store(0, std::memory_order_relaxed);
+                active = threads.size();
+                generation++;
+            }
+
+            wake.notify_all();
+            run_chunks();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [this](){return active == 0;});
+            job_body = nullptr;
+        }
+
+        ThreadPool(const ThreadPool &other) = delete;
+        ThreadPool &operator=(const ThreadPool &other) = delete;
+
+    private:
+        /**
+         * Returns the default number of worker threads - one less than the hardware threads, as the thread starting a
+         * job works on it too.
+         *
+         * @return The default number of worker threads.
+         */
+        static size_t default_workers()
+        {
+            const size_t hardware = std::thread::hardware_concurrency();
+
+            return hardware > 1 ? hardware - 1 : 0;
+        }
+
+        /** Worker thread loop. */
+        void work()
+        {
+            uint64_t seen = 0;
+            while (true)
+            {
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&](){return stopping || generation != seen;});
+                    if (stopping)
+                    {
+                        return;
+                    }
+
+                    seen = generation;
+                }
+
+                run_chunks();
+
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--active == 0)
+                {
+                    done.notify_one();
+                }
+            }
+        }
+
+        /** Claim and run chunks of the current job until there are none left. */
+        void run_chunks()
+        {
+            for (size_t begin = next.fetch_add(job_chunk, std::memory_order_relaxed); begin < job_count;
+                 begin = next.fetch_add(job_chunk, std::memory_order_relaxed))
+            {
+                (*job_body)(begin, std::min(begin + job_chunk, job_count));
+            }
+        }
+
+        /** The worker threads. */
+        std::vector<std::thread> threads;
+
+        /** Serializes jobs. */
+        std::mutex job_mutex;
+
+        /** Protects the job state below. */
+        std::mutex mutex;
+
+        /** Signals the workers that a job started or the pool is stopping. */
+        std::condition_variable wake;
+
+        /** Signals the job's thread that the workers are done. */
+        std::condition_variable done;
+
+        /** The current job's body. */
+        const Body *job_body = nullptr;
+
+        /** The current job's range size. */
+        size_t job_count = 0;
+
+        /** The current job's chunk size. */
+        size_t job_chunk = 1;
+
+        /** Start of the next unclaimed chunk. */
+        std::atomic<size_t> next{0};
+
+        /** Workers not yet done with the current job. */
+        size_t active = 0;
+
+        /** Job counter, so workers can tell a new job from a spurious wake up. */
+        uint64_t generation = 0;
+
+        /** Whether the pool is being destroyed. */
+        bool stopping = false;
+    };
+}
@@ -0,0 +1,476 @@
+#pragma once
+/*
+ * Copyright 2019-2022
+ * Authored by: Ben Diamand
+ *
+ * English version - you can use this for whatever you want. Attribution much
+ * appreciated but not required.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * Anyone is free to copy, modify, publish, use, compile, sell, or
+ * distribute this software, either in source code form or as part of a compiled
+ * binary, for any purpose, commercial or non-commercial, and by any means,
+ * subject to the following conditions(s):
+ *
+ * ** This comment block must remain in this and derived works.
+ */
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "c_callback.h"
+
+#if !defined(__x86_64__) || !defined(__linux__)
+ #error "Thunk pools need x86-64 Linux."
+#endif
+
+namespace delegate
+{
+    /** Allow the size of the executable slabs thunks are allocated from to be specified as a compile-time constant. */
+    #ifndef DELEGATE_THUNK_SLAB_SIZE
+     #define DELEGATE_THUNK_SLAB_SIZE 65536
+     #define DELEGATE_THUNK_SLAB_SIZE_UNDEF
+    #endif
+
+    template<typename Result, typename... Arguments>
+    class Thunk;
+
+    /**
+     * Pool of executable thunks: plain function pointers, with no context argument, which call a delegate (e.g. for
+     * qsort, signal style registries or legacy plugin APIs).
+     *
+     * Each thunk is a small stub which shifts the integer argument registers up by one, loads the delegate's address
+     * as the first argument and jumps to the signature's CBridge trampoline.  So a thunk works for signatures with at
+     * most five integer or pointer arguments (float and double arguments are passed separately and don't count) and
+     * a void, integer, pointer, float or double result - which is checked at compile time.
+     *
+     * Stubs are allocated from slabs mapped twice from one memory file, writable at one address and executable at
+     * another, so no page is ever writable and executable at once, and creating a thunk is a lock and a 64 byte copy.
+     * The delegate must outlive its thunk, and every thunk must be released before the pool is destroyed.
+     *
+     * Example:
+     *      static delegate::ThunkPool pool;
+     *      delegate::Delegate<int, const void *, const void *> compare = [&order](const void *, const void *){...};
+     *      const auto thunk = pool.make_thunk(compare);
+     *      qsort(values, count, sizeof(*values), thunk.function());
+     */
+    class ThunkPool
+    {
+    public:
+        /** The bytes per thunk. */
+        static constexpr size_t slot_size = 64;
+
+        /** The bytes per slab. */
+        static constexpr size_t slab_size = DELEGATE_THUNK_SLAB_SIZE;
+
+        static_assert(slab_size % slot_size == 0, "Slabs must hold a whole number of thunks.");
+
+        /** Default constructor.  Slabs are mapped as thunks are made. */
+        ThunkPool() = default;
+
+        ThunkPool(const ThunkPool &other) = delete;
+        ThunkPool &operator=(const ThunkPool &other) = delete;
+
+        /** Destructor.  Terminates if any thunk hasn't been released. */
+        ~ThunkPool()
+        {
+            if (live != 0)
+            {
+                std::terminate();
+            }
+
+            for (const Slab &slab : slabs)
+            {
+                ::munmap(slab.writable, slab_size);
+                ::munmap(slab.executable, slab_size);
+            }
+        }
+
+        /**
+         * Make a thunk calling a delegate.
+         *
+         * @param delegate The delegate, which must outlive the thunk.
+         *
+         * @return Returns the thunk, which is empty if no executable memory could be mapped.
+         */
+        template<template<typename, typename...> class DelegateType, typename Result, typename... Arguments>
+        Thunk<Result, Arguments...> make_thunk(const DelegateType<Result, Arguments...> &delegate)
+        {
+            static_assert(is_register_result<Result>(), "Thunk results must be void, integers, pointers or floats.");
+            static_assert((is_register_argument<Arguments>() && ...),
+                          "Thunk arguments must be integers, pointers, references or floats.");
+            static_assert((size_t(0) + ... + size_t(!is_sse_class<Arguments>())) <= 5,
+                          "Thunks support at most five integer or pointer arguments.");
+
+            const Slot slot = allocate();
+            if (slot.executable)
+            {
+                write_stub(slot, &delegate, &CBridge<DelegateType<Result, Arguments...>>::context_first);
+            }
+
+            return Thunk<Result, Arguments...>(slot.executable ? this : nullptr, slot);
+        }
+
+        /**
+         * Returns the number of thunks not yet released.
+         *
+         * @return The number of thunks.
+         */
+        size_t size()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            return live;
+        }
+
+    private:
+        template<typename, typename...>
+        friend class Thunk;
+
+        /** A slab, mapped writable and executable. */
+        struct Slab
+        {
+            uint8_t *writable;
+            uint8_t *executable;
+        };
+
+        /** A thunk's memory, at its writable and executable addresses. */
+        struct Slot
+        {
+            uint8_t *writable;
+            uint8_t *executable;
+        };
+
+        /** Determine whether a type is passed in a floating point register. */
+        template<typename T>
+        static constexpr bool is_sse_class()
+        {
+            return std::is_same_v<T, float> || std::is_same_v<T, double>;
+        }
+
+        /** Determine whether a type is passed in a general purpose register. */
+        template<typename T>
+        static constexpr bool is_integer_class()
+        {
+            return std::is_reference_v<T> || ((std::is_integral_v<T> || std::is_pointer_v<T> || std::is_enum_v<T> ||
+                                               std::is_null_pointer_v<T>) && sizeof(T) <= sizeof(uint64_t));
+        }
+
+        /** Determine whether a type can be a thunk argument. */
+        template<typename T>
+        static constexpr bool is_register_argument()
+        {
+            return is_integer_class<T>() || is_sse_class<T>();
+        }
+
+        /** Determine whether a type can be a thunk result (one not returned through a hidden pointer argument). */
+        template<typename T>
+        static constexpr bool is_register_result()
+        {
+            if constexpr (std::is_void_v<T>)
+            {
+                return true;
+            }
+            else
+            {
+                return is_register_argument<T>();
+            }
+        }
+
+        /**
+         * Write a stub calling a trampoline with a context as its first argument.
+         *
+         * @param slot The thunk's memory.
+         * @param context The context.
+         * @param trampoline The trampoline.
+         */
+        template<typename Trampoline>
+        static void write_stub(const Slot &slot, const void *context, Trampoline trampoline)
+        {
+            std::array<uint8_t, slot_size> code;
+            code.fill(int3);
+
+            static constexpr uint8_t shift[] = {
+                0x4d, 0x89, 0xc1,   // mov r9, r8
+                0x49, 0x89, 0xc8,   // mov r8, rcx
+                0x48, 0x89, 0xd1,   // mov rcx, rdx
+                0x48, 0x89, 0xf2,   // mov rdx, rsi
+                0x48, 0x89, 0xfe,   // mov rsi, rdi
+                0x48, 0xbf};        // movabs rdi, context
+            static constexpr uint8_t load[] = {0x49, 0xbb};           // movabs r11, trampoline
+            static constexpr uint8_t jump[] = {0x41, 0xff, 0xe3};     // jmp r11
+
+            const uint64_t context_address = reinterpret_cast<uintptr_t>(context);
+            const uint64_t trampoline_address = reinterpret_cast<uintptr_t>(trampoline);
+            uint8_t *out = code.data();
+            out = static_cast<uint8_t *>(memcpy(out, shift, sizeof(shift))) + sizeof(shift);
+            out = static_cast<uint8_t *>(memcpy(out, &context_address, sizeof(context_address))) + sizeof(uint64_t);
+            out = static_cast<uint8_t *>(memcpy(out, load, sizeof(load))) + sizeof(load);
+            out = static_cast<uint8_t *>(memcpy(out, &trampoline_address, sizeof(trampoline_address))) +
+                  sizeof(uint64_t);
+            memcpy(out, jump, sizeof(jump));
+
+            memcpy(slot.writable, code.data(), code.size());
+        }
+
+        /**
+         * Allocate a thunk's memory, from the newest slab, else the longest released, else a new slab.  Memory is
+         * reused as late as possible, because writing code the CPU ran recently is slow.
+         *
+         * @return Returns the memory, which is null if a new slab couldn't be mapped.
+         */
+        Slot allocate()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            if ((slabs.empty() || slab_used == slab_size) && !free_slots.empty())
+            {
+                const Slot slot = free_slots.front();
+                free_slots.pop_front();
+                live++;
+
+                return slot;
+            }
+
+            if (slabs.empty() || slab_used == slab_size)
+            {
+                const Slab slab = map_slab();
+                if (!slab.executable)
+                {
+                    return Slot{nullptr, nullptr};
+                }
+
+                slabs.push_back(slab);
+                slab_used = 0;
+            }
+
+            const size_t offset = slot_offset(slab_used / slot_size);
+            const Slot slot{slabs.back().writable + offset, slabs.back().executable + offset};
+            slab_used += slot_size;
+            live++;
+
+            return slot;
+        }
+
+        /**
+         * Returns the offset in a slab of the nth slot handed out.  Consecutive slots are on different pages, so a
+         * new stub isn't written next to one just run (which the CPU may have fetched along with it).
+         *
+         * @param index The number of slots handed out before.
+         *
+         * @return The offset.
+         */
+        static size_t slot_offset(size_t index)
+        {
+            constexpr size_t page_size = 4096;
+            constexpr size_t pages = slab_size / page_size;
+            if constexpr (pages < 2 || slab_size % page_size != 0)
+            {
+                return index * slot_size;
+            }
+            else
+            {
+                return index % pages * page_size + index / pages * slot_size;
+            }
+        }
+
+        /**
+         * Release a thunk's memory.  The stub is overwritten with breakpoints, so a stale function pointer traps.
+         *
+         * @param slot The thunk's memory.
+         */
+        void release(const Slot &slot)
+        {
+            memset(slot.writable, int3, slot_size);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            free_slots.push_back(slot);
+            live--;
+        }
+
+        /**
+         * Map a slab twice from a new memory file.
+         *
+         * @return Returns the slab, which has null addresses on failure.
+         */
+        static Slab map_slab()
+        {
+            Slab slab{nullptr, nullptr};
+
+            const int fd = ::memfd_create("delegate_thunks", MFD_CLOEXEC);
+            if (fd < 0)
+            {
+                return slab;
+            }
+
+            if (::ftruncate(fd, off_t(slab_size)) == 0)
+            {
+                void *writable = ::mmap(nullptr, slab_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+                void *executable = ::mmap(nullptr, slab_size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+                if (writable != MAP_FAILED && executable != MAP_FAILED)
+                {
+                    memset(writable, int3, slab_size);
+                    slab = Slab{static_cast<uint8_t *>(writable), static_cast<uint8_t *>(executable)};
+                }
+                else
+                {
+                    if (writable != MAP_FAILED)
+                    {
+                        ::munmap(writable, slab_size);
+                    }
+                    if (executable != MAP_FAILED)
+                    {
+                        ::munmap(executable, slab_size);
+                    }
+                }
+            }
+            ::close(fd);
+
+            return slab;
+        }
+
+        /** The breakpoint instruction, filling unused stub memory. */
+        static constexpr uint8_t int3 = 0xcc;
+
+        /** Guards the slabs and free list. */
+        std::mutex mutex;
+
+        /** The slabs, newest last. */
+        std::vector<Slab> slabs;
+
+        /** The bytes of the newest slab handed out. */
+        size_t slab_used = 0;
+
+        /** Released thunk memory, oldest first. */
+        std::deque<Slot> free_slots;
+
+        /** The number of thunks not yet released. */
+        size_t live = 0;
+    };
+
+    /**
+     * A thunk made by a ThunkPool: a plain function pointer calling a delegate.  Releases its memory to the pool on
+     * destruction.
+     *
+     * @tparam Result The return type.
+     * @tparam Arguments The function arguments.
+     */
+    template<typename Result, typename... Arguments>
+    class Thunk
+    {
+    public:
+        /** The function pointer type. */
+        using Function = Result (*)(Arguments...);
+
+        /** Default constructor.  An empty thunk. */
+        Thunk() : pool(nullptr), slot{nullptr, nullptr}
+        {
+        }
+
+        Thunk(const Thunk &other) = delete;
+        Thunk &operator=(const Thunk &other) = delete;
+
+        /**
+         * Move constructor.
+         *
+         * @param other The thunk to move, which is left empty.
+         */
+        Thunk(Thunk &&other) noexcept : pool(other.pool), slot(other.slot)
+        {
+            other.pool = nullptr;
+        }
+
+        /**
+         * Move assignment.  Releases this thunk first.
+         *
+         * @param other The thunk to move, which is left empty.
+         *
+         * @return Returns this thunk.
+         */
+        Thunk &operator=(Thunk &&other) noexcept
+        {
+            if (this != &other)
+            {
+                release();
+                pool = other.pool;
+                slot = other.slot;
+                other.pool = nullptr;
+            }
+
+            return *this;
+        }
+
+        /** Destructor.  Releases the thunk. */
+        ~Thunk()
+        {
+            release();
+        }
+
+        /**
+         * Returns the function pointer, which is valid until the thunk is released.
+         *
+         * @return The function pointer, or nullptr if empty.
+         */
+        Function function() const
+        {
+            return pool ? reinterpret_cast<Function>(slot.executable) : nullptr;
+        }
+
+        /**
+         * Determine whether the thunk holds a function.
+         *
+         * @return Returns true if the thunk holds a function, else false.
+         */
+        explicit operator bool() const
+        {
+            return pool != nullptr;
+        }
+
+        /** Release the thunk to its pool, leaving it empty. */
+        void release()
+        {
+            if (pool)
+            {
+                pool->release(slot);
+                pool = nullptr;
+            }
+        }
+
+    private:
+        friend class ThunkPool;
+
+        /**
+         * Constructor, used by ThunkPool.
+         *
+         * @param pool The pool, or nullptr if empty.
+         * @param slot The thunk's memory.
+         */
+        Thunk(ThunkPool *pool, const ThunkPool::Slot &slot) : pool(pool), slot(slot)
+        {
+        }
+
+        /** The pool the thunk's memory came from. */
+        ThunkPool *pool;
+
+        /** The thunk's memory. */
+        ThunkPool::Slot slot;
+    };
+
+    #ifdef DELEGATE_THUNK_SLAB_SIZE_UNDEF
+     #undef DELEGATE_THUNK_SLAB_SIZE
+     #undef DELEGATE_THUNK_SLAB_SIZE_UNDEF
+    #endif
+}